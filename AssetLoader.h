@@ -0,0 +1,203 @@
+#pragma once
+#include <filesystem>
+#include <fstream>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <chrono>
+#include <array>
+#include <deque>
+#include <vector>
+#include <memory>
+#include <string_view>
+#include <unordered_map>
+#include <algorithm>
+
+#include "Trace.h"
+#include "GamePack.h"
+
+namespace fs = std::filesystem;
+
+// Reads asset files on background threads in priority order. Decoding and texture creation stay on the
+// main thread (DxLib is not thread safe); the main thread takes finished reads with pop() a few per frame.
+// Files of packed games are not read at all but looked up in the mapped pack.
+class AssetLoader {
+public:
+  enum Priority {
+    Visible = 0,
+    Neighbor,
+    Background,
+    PriorityCount
+  };
+  struct Loaded {
+    size_t key = 0;
+    // As passed to request(), so that the caller can tell a read it no longer wants.
+    uint32_t generation = 0;
+    fs::path path;
+    std::vector<char> data;
+    // Set instead of data for a file in a pack: the contents where they lie in the mapping, which pack
+    // keeps alive.
+    std::string_view view;
+    std::shared_ptr<const GamePack> pack;
+    bool ok = false;
+    std::chrono::steady_clock::time_point requested;
+  };
+  struct Stats {
+    size_t queued = 0;
+    size_t ready = 0;
+    size_t loaded = 0;
+    long long avgLatencyUs = 0;
+    long long maxLatencyUs = 0;
+  };
+private:
+  struct Job {
+    uint32_t generation;
+    fs::path path;
+    bool read;
+    std::chrono::steady_clock::time_point requested;
+  };
+  std::vector<std::thread> workers;
+  GamePacks* packs;
+  mutable std::mutex mtx;
+  std::condition_variable cv;
+  std::unordered_map<size_t, Job> jobs;
+  std::unordered_map<size_t, int> priorityOf;
+  // A key can sit in several queues after being reprioritized; only the entry matching priorityOf counts.
+  std::array<std::deque<size_t>, PriorityCount> queues;
+  std::vector<Loaded> ready;
+  bool paused = false;
+  bool quit = false;
+  size_t loaded = 0;
+  long long totalLatencyUs = 0, maxLatencyUs = 0;
+
+  // Lookups never insert: a key without an entry has no job pending or in flight.
+  int priority(size_t key) const {
+    auto itr = priorityOf.find(key);
+    return itr != priorityOf.end() ? itr->second : PriorityCount;
+  }
+  bool next(size_t& key, Job& job) {
+    for (int p = 0; p < PriorityCount; ++p) {
+      auto& q = queues[p];
+      while (!q.empty()) {
+        size_t k = q.front();
+        q.pop_front();
+        auto itr = jobs.find(k);
+        if (itr == jobs.end() || priority(k) != p)continue;
+        key = k;
+        job = std::move(itr->second);
+        jobs.erase(itr);
+        return true;
+      }
+    }
+    return false;
+  }
+  void run() {
+    Trace::nameThread("AssetLoader");
+    for (;;) {
+      size_t key;
+      Job job;
+      {
+        std::unique_lock<std::mutex> lock(mtx);
+        cv.wait(lock, [this] { return quit || (!paused && !jobs.empty()); });
+        if (quit)return;
+        if (!next(key, job))continue;
+      }
+      TraceSpan span("read");
+      Loaded result;
+      result.key = key;
+      result.generation = job.generation;
+      result.path = job.path;
+      result.requested = job.requested;
+      std::error_code ec;
+      if (packs && packs->read(job.path, result.view, result.pack))result.ok = true;
+      else if (result.pack)result.pack.reset();
+      else if (job.read) {
+        std::ifstream ifs(job.path, std::ios::binary | std::ios::ate);
+        if (ifs.is_open()) {
+          result.data.resize(static_cast<size_t>(ifs.tellg()));
+          ifs.seekg(0);
+          result.ok = static_cast<bool>(ifs.read(result.data.data(), result.data.size()));
+        }
+      }
+      else result.ok = fs::is_regular_file(job.path, ec);
+      std::lock_guard<std::mutex> lock(mtx);
+      ready.push_back(std::move(result));
+    }
+  }
+public:
+  explicit AssetLoader(size_t threads = 2, GamePacks* packs = nullptr) : packs(packs) {
+    for (size_t i = 0; i < threads; ++i)
+      workers.emplace_back([this] { run(); });
+  }
+  AssetLoader(const AssetLoader&) = delete;
+  AssetLoader& operator=(const AssetLoader&) = delete;
+  ~AssetLoader() {
+    {
+      std::lock_guard<std::mutex> lock(mtx);
+      quit = true;
+    }
+    cv.notify_all();
+    for (auto& t : workers)t.join();
+  }
+
+  // read = false only checks that the file exists (movies are opened by DxLib itself). A new request for
+  // a key replaces one still queued; a read already in flight still comes back with its own generation.
+  void request(size_t key, uint32_t generation, const fs::path& path, Priority priority, bool read = true) {
+    {
+      std::lock_guard<std::mutex> lock(mtx);
+      jobs[key] = Job{ generation, path, read, std::chrono::steady_clock::now() };
+      priorityOf[key] = priority;
+      queues[priority].push_back(key);
+    }
+    cv.notify_one();
+  }
+  void prioritize(size_t key, Priority priority) {
+    std::lock_guard<std::mutex> lock(mtx);
+    auto itr = priorityOf.find(key);
+    if (itr == priorityOf.end() || itr->second == priority)return;
+    itr->second = priority;
+    if (jobs.count(key))queues[priority].push_back(key);
+  }
+  // Hands out the finished read with the highest current priority. The key keeps its priority while it
+  // was requested again and that read is still to come.
+  bool pop(Loaded& out) {
+    std::lock_guard<std::mutex> lock(mtx);
+    if (ready.empty())return false;
+    auto best = std::min_element(ready.begin(), ready.end(), [this](const Loaded& a, const Loaded& b) {
+      return priority(a.key) < priority(b.key);
+    });
+    out = std::move(*best);
+    ready.erase(best);
+    if (!jobs.count(out.key))priorityOf.erase(out.key);
+    return true;
+  }
+  // Called by the main thread once the asset is usable, to account for the request-to-ready latency.
+  void finish(const Loaded& item) {
+    long long us = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - item.requested).count();
+    std::lock_guard<std::mutex> lock(mtx);
+    ++loaded;
+    totalLatencyUs += us;
+    maxLatencyUs = std::max(maxLatencyUs, us);
+  }
+  void pause(bool p) {
+    {
+      std::lock_guard<std::mutex> lock(mtx);
+      paused = p;
+    }
+    cv.notify_all();
+  }
+  bool idle() const {
+    std::lock_guard<std::mutex> lock(mtx);
+    return jobs.empty() && ready.empty() && priorityOf.empty();
+  }
+  Stats stats() const {
+    std::lock_guard<std::mutex> lock(mtx);
+    Stats s;
+    s.queued = jobs.size();
+    s.ready = ready.size();
+    s.loaded = loaded;
+    s.avgLatencyUs = loaded ? totalLatencyUs / static_cast<long long>(loaded) : 0;
+    s.maxLatencyUs = maxLatencyUs;
+    return s;
+  }
+};
@@ -0,0 +1,338 @@
+#pragma once
+#include <filesystem>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <unordered_set>
+#include <unordered_map>
+#include <vector>
+#include <algorithm>
+#include <climits>
+#include <cstdint>
+#include <cstring>
+
+#include "CatalogIndex.h"
+
+namespace fs = std::filesystem;
+
+// Holds the catalog's strings in large blocks that never move, so views into them stay valid for the
+// lifetime of the arena. Every string is followed by a NUL; data() of a view can be passed to C APIs.
+class StringArena {
+  static constexpr size_t BlockChars = 16 * 1024;
+  std::vector<std::unique_ptr<wchar_t[]>> blocks;
+  wchar_t* block = nullptr;
+  size_t used = BlockChars;
+  size_t allocated = 0;
+  std::unordered_set<std::wstring_view> interned;
+public:
+  std::wstring_view store(std::wstring_view s) {
+    size_t need = s.size() + 1;
+    wchar_t* p;
+    if (need > BlockChars / 4) {
+      // Long strings get a block of their own, leaving the current one to fill up.
+      blocks.emplace_back(new wchar_t[need]);
+      p = blocks.back().get();
+      allocated += need;
+    }
+    else {
+      if (used + need > BlockChars) {
+        blocks.emplace_back(new wchar_t[BlockChars]);
+        block = blocks.back().get();
+        used = 0;
+        allocated += BlockChars;
+      }
+      p = block + used;
+      used += need;
+    }
+    std::memcpy(p, s.data(), s.size() * sizeof(wchar_t));
+    p[s.size()] = L'\0';
+    return std::wstring_view(p, s.size());
+  }
+  // Like store(), but equal strings share one copy. For the values that repeat across games (versions,
+  // file names), not for titles and descriptions.
+  std::wstring_view intern(std::wstring_view s) {
+    auto itr = interned.find(s);
+    if (itr != interned.end())return *itr;
+    std::wstring_view v = store(s);
+    interned.insert(v);
+    return v;
+  }
+  void clear() {
+    blocks.clear();
+    block = nullptr;
+    used = BlockChars;
+    allocated = 0;
+    interned.clear();
+  }
+  size_t bytes() const {
+    return allocated * sizeof(wchar_t) + interned.size() * (sizeof(std::wstring_view) + 2 * sizeof(void*));
+  }
+};
+
+// Layout of a catalog published in shared memory by CatalogService: the header, one record per game, the
+// ids of the games that are not removed by difficulty (the order the menu starts with), and the strings,
+// each followed by a NUL. Text offsets and lengths count characters from the first string.
+struct CatalogImage {
+  static constexpr char Magic[4] = { 'L', 'C', 'A', 'T' };
+  static constexpr uint32_t Version = 2;
+  // The range SettingsParser accepts, which Menu's DiffiCultyStr is indexed with.
+  static constexpr int MinDifficulty = -1;
+  static constexpr int MaxDifficulty = 2;
+  struct Text {
+    uint32_t offset, length;
+  };
+  struct Record {
+    Text dir, title, version, description, executable, icon, detail;
+    int8_t difficulty;
+    uint8_t movie;
+    uint8_t removed;
+    uint8_t reserved;
+  };
+  struct Header {
+    char magic[4];
+    uint32_t version;
+    uint32_t charSize;
+    uint32_t games;
+    uint32_t removed;
+    uint32_t reserved;
+    uint64_t generation;
+    uint64_t chars;
+    // Of the whole image.
+    uint64_t bytes;
+  };
+  static_assert(sizeof(Header) == 48 && sizeof(Record) % alignof(uint32_t) == 0, "image layout");
+};
+
+// The games shown by the launcher, one column per field. Paths to a game's files are kept relative to
+// its folder and joined only when a file is actually opened.
+// A game keeps its index for the lifetime of the catalog: a game that goes away is only marked removed,
+// so that the textures and the search index keyed by index can be updated in place.
+// A catalog attached to an image (CatalogService) reads every field from the image and owns no copy of
+// it; it is read-only.
+class Catalog {
+  StringArena strings;
+  std::vector<std::wstring_view> dirs;
+  std::vector<std::wstring_view> titles;
+  std::vector<std::wstring_view> versions;
+  std::vector<std::wstring_view> descriptions;
+  std::vector<std::wstring_view> executables;
+  std::vector<std::wstring_view> icons;
+  std::vector<std::wstring_view> details;
+  std::vector<int8_t> difficulties;
+  std::vector<uint8_t> movies;
+  std::vector<uint8_t> removals;
+  size_t removedCount = 0;
+  const CatalogImage::Header* image = nullptr;
+  const CatalogImage::Record* records = nullptr;
+  const uint32_t* published = nullptr;
+  const wchar_t* chars = nullptr;
+
+  std::wstring_view field(const std::vector<std::wstring_view>& column, CatalogImage::Text CatalogImage::Record::* text, size_t i) const {
+    if (!image)return column[i];
+    const CatalogImage::Text& t = records[i].*text;
+    return std::wstring_view(chars + t.offset, t.length);
+  }
+
+  // Files outside the game's folder are kept as they are.
+  std::wstring_view relative(const fs::path& file, const fs::path& dir) {
+    fs::path rel = file.lexically_relative(dir);
+    return strings.intern((rel.empty() || *rel.begin() == ".." ? file : rel).wstring());
+  }
+public:
+  size_t size() const {
+    return image ? image->games : dirs.size();
+  }
+  bool empty() const {
+    return size() == 0;
+  }
+  void reserve(size_t n) {
+    for (auto* column : { &dirs, &titles, &versions, &descriptions, &executables, &icons, &details })column->reserve(n);
+    difficulties.reserve(n);
+    movies.reserve(n);
+    removals.reserve(n);
+  }
+  void clear() {
+    for (auto* column : { &dirs, &titles, &versions, &descriptions, &executables, &icons, &details })column->clear();
+    difficulties.clear();
+    movies.clear();
+    removals.clear();
+    removedCount = 0;
+    strings.clear();
+    image = nullptr;
+    records = nullptr;
+    published = nullptr;
+    chars = nullptr;
+  }
+  // Returns the new game's index.
+  size_t add(const CatalogEntry& e) {
+    dirs.push_back(strings.store(e.dir.wstring()));
+    titles.push_back(strings.store(e.title));
+    versions.push_back(strings.intern(e.version));
+    descriptions.push_back(strings.store(e.description));
+    executables.push_back(relative(e.executable, e.dir));
+    icons.push_back(relative(e.icon, e.dir));
+    details.push_back(relative(e.detail, e.dir));
+    difficulties.push_back(static_cast<int8_t>(e.difficulty));
+    movies.push_back(e.is_movie);
+    removals.push_back(0);
+    return dirs.size() - 1;
+  }
+  // Replaces the fields of game i, which comes back if it was removed. The old strings stay in the arena
+  // until the catalog is cleared.
+  void update(size_t i, const CatalogEntry& e) {
+    titles[i] = strings.store(e.title);
+    versions[i] = strings.intern(e.version);
+    descriptions[i] = strings.store(e.description);
+    executables[i] = relative(e.executable, e.dir);
+    icons[i] = relative(e.icon, e.dir);
+    details[i] = relative(e.detail, e.dir);
+    difficulties[i] = static_cast<int8_t>(e.difficulty);
+    movies[i] = e.is_movie;
+    if (removals[i])--removedCount;
+    removals[i] = 0;
+  }
+  void remove(size_t i) {
+    if (!removals[i])++removedCount;
+    removals[i] = 1;
+  }
+  bool removed(size_t i) const {
+    return image ? records[i].removed != 0 : removals[i] != 0;
+  }
+  // Games that are not removed.
+  size_t live() const {
+    return image ? image->games - image->removed : dirs.size() - removedCount;
+  }
+
+  std::wstring_view title(size_t i) const {
+    return field(titles, &CatalogImage::Record::title, i);
+  }
+  std::wstring_view version(size_t i) const {
+    return field(versions, &CatalogImage::Record::version, i);
+  }
+  std::wstring_view description(size_t i) const {
+    return field(descriptions, &CatalogImage::Record::description, i);
+  }
+  int difficulty(size_t i) const {
+    return image ? records[i].difficulty : difficulties[i];
+  }
+  bool isMovie(size_t i) const {
+    return image ? records[i].movie != 0 : movies[i] != 0;
+  }
+  fs::path dir(size_t i) const {
+    return fs::path(field(dirs, &CatalogImage::Record::dir, i));
+  }
+  fs::path executable(size_t i) const {
+    return dir(i) / field(executables, &CatalogImage::Record::executable, i);
+  }
+  fs::path icon(size_t i) const {
+    return dir(i) / field(icons, &CatalogImage::Record::icon, i);
+  }
+  fs::path detail(size_t i) const {
+    return dir(i) / field(details, &CatalogImage::Record::detail, i);
+  }
+
+  // Serializes the catalog, removed games included so that indices stay the same. Strings shared in the
+  // arena are written once.
+  void writeImage(std::vector<char>& out, uint64_t generation) const {
+    size_t n = size();
+    std::vector<CatalogImage::Record> recs(n);
+    std::vector<wchar_t> text;
+    std::unordered_map<const wchar_t*, uint32_t> written;
+    auto put = [&](std::wstring_view s) {
+      auto itr = written.find(s.data());
+      if (itr != written.end())return CatalogImage::Text{ itr->second, static_cast<uint32_t>(s.size()) };
+      uint32_t offset = static_cast<uint32_t>(text.size());
+      text.insert(text.end(), s.begin(), s.end());
+      text.push_back(L'\0');
+      written.emplace(s.data(), offset);
+      return CatalogImage::Text{ offset, static_cast<uint32_t>(s.size()) };
+    };
+    size_t removedGames = 0;
+    std::vector<uint32_t> order;
+    for (size_t i = 0; i < n; ++i) {
+      CatalogImage::Record& r = recs[i];
+      r.dir = put(field(dirs, &CatalogImage::Record::dir, i));
+      r.title = put(title(i));
+      r.version = put(version(i));
+      r.description = put(description(i));
+      r.executable = put(field(executables, &CatalogImage::Record::executable, i));
+      r.icon = put(field(icons, &CatalogImage::Record::icon, i));
+      r.detail = put(field(details, &CatalogImage::Record::detail, i));
+      r.difficulty = static_cast<int8_t>(difficulty(i));
+      r.movie = isMovie(i);
+      r.removed = removed(i);
+      r.reserved = 0;
+      if (r.removed)++removedGames;
+      else order.push_back(static_cast<uint32_t>(i));
+    }
+    // SearchIndex::ByDifficulty: unknown difficulty last, then catalog order.
+    auto key = [&](uint32_t i) { return recs[i].difficulty < 0 ? INT_MAX : recs[i].difficulty; };
+    std::stable_sort(order.begin(), order.end(), [&](uint32_t a, uint32_t b) { return key(a) < key(b); });
+    CatalogImage::Header h{};
+    std::memcpy(h.magic, CatalogImage::Magic, sizeof(h.magic));
+    h.version = CatalogImage::Version;
+    h.charSize = sizeof(wchar_t);
+    h.games = static_cast<uint32_t>(n);
+    h.removed = static_cast<uint32_t>(removedGames);
+    h.generation = generation;
+    h.chars = text.size();
+    h.bytes = sizeof(h) + n * sizeof(CatalogImage::Record) + order.size() * sizeof(uint32_t) + text.size() * sizeof(wchar_t);
+    out.resize(static_cast<size_t>(h.bytes));
+    char* p = out.data();
+    std::memcpy(p, &h, sizeof(h));
+    p += sizeof(h);
+    if (n > 0)std::memcpy(p, recs.data(), n * sizeof(CatalogImage::Record));
+    p += n * sizeof(CatalogImage::Record);
+    if (!order.empty())std::memcpy(p, order.data(), order.size() * sizeof(uint32_t));
+    p += order.size() * sizeof(uint32_t);
+    if (!text.empty())std::memcpy(p, text.data(), text.size() * sizeof(wchar_t));
+  }
+  // Reads the catalog from an image in place of its own columns. The image must stay mapped until the
+  // catalog is cleared or attached to another one. Every record is checked first, so that a stale or
+  // corrupt image is turned down rather than read out of bounds.
+  bool attach(const void* data, size_t bytes) {
+    auto h = static_cast<const CatalogImage::Header*>(data);
+    if (bytes < sizeof(*h) || std::memcmp(h->magic, CatalogImage::Magic, sizeof(h->magic)) != 0 || h->version != CatalogImage::Version
+      || h->charSize != sizeof(wchar_t) || h->bytes > bytes || h->removed > h->games || h->chars > bytes
+      || h->bytes != sizeof(*h) + static_cast<uint64_t>(h->games) * sizeof(CatalogImage::Record)
+        + static_cast<uint64_t>(h->games - h->removed) * sizeof(uint32_t) + h->chars * sizeof(wchar_t))return false;
+    auto recs = reinterpret_cast<const CatalogImage::Record*>(h + 1);
+    auto order = reinterpret_cast<const uint32_t*>(recs + h->games);
+    auto text = reinterpret_cast<const wchar_t*>(order + (h->games - h->removed));
+    uint32_t removedGames = 0;
+    for (uint32_t i = 0; i < h->games; ++i) {
+      const CatalogImage::Record& r = recs[i];
+      // Each string is followed by a NUL inside the image.
+      for (const CatalogImage::Text& t : { r.dir, r.title, r.version, r.description, r.executable, r.icon, r.detail })
+        if (static_cast<uint64_t>(t.offset) + t.length >= h->chars || text[t.offset + t.length] != L'\0')return false;
+      if (r.difficulty < CatalogImage::MinDifficulty || CatalogImage::MaxDifficulty < r.difficulty)return false;
+      if (r.removed)++removedGames;
+    }
+    if (removedGames != h->removed)return false;
+    for (uint32_t i = 0; i < h->games - h->removed; ++i)
+      if (order[i] >= h->games || recs[order[i]].removed)return false;
+    clear();
+    image = h;
+    records = recs;
+    published = order;
+    chars = text;
+    return true;
+  }
+  // The games that are not removed by difficulty, live() of them, as published with an attached image;
+  // null if the catalog is its own.
+  const uint32_t* publishedOrder() const {
+    return published;
+  }
+  // Generation of the attached image, 0 if the catalog is its own.
+  uint64_t generation() const {
+    return image ? image->generation : 0;
+  }
+
+  // Memory held by the catalog: the string blocks plus the columns; an attached image is not counted.
+  size_t bytes() const {
+    size_t n = strings.bytes() + difficulties.capacity() + movies.capacity() + removals.capacity();
+    for (auto* column : { &dirs, &titles, &versions, &descriptions, &executables, &icons, &details })
+      n += column->capacity() * sizeof(std::wstring_view);
+    return n;
+  }
+};
@@ -0,0 +1,232 @@
+#pragma once
+#include <filesystem>
+#include <fstream>
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include <cstdint>
+#include <cstring>
+
+#include "GameScanner.h"
+
+#ifdef _WIN32
+#include <windows.h>
+#endif
+
+namespace fs = std::filesystem;
+
+inline fs::path exeDir() {
+#ifdef _WIN32
+  wchar_t buf[MAX_PATH] = {};
+  if (GetModuleFileNameW(NULL, buf, MAX_PATH) > 0)return fs::path(buf).parent_path();
+#else
+  std::error_code ec;
+  fs::path self = fs::read_symlink("/proc/self/exe", ec);
+  if (!ec)return self.parent_path();
+#endif
+  return fs::current_path();
+}
+
+// Parsed contents of one settings.json, together with the stamp of the file it came from.
+struct CatalogEntry {
+  fs::path dir;
+  int64_t metaTime = 0;
+  uint64_t metaSize = 0;
+  bool valid = false;
+  std::wstring title;
+  std::wstring version;
+  std::wstring description;
+  fs::path executable;
+  fs::path icon;
+  fs::path detail;
+  bool is_movie = false;
+  int difficulty = -1;
+};
+
+class CatalogIndex {
+private:
+  static constexpr char Magic[4] = { 'L', 'C', 'I', 'X' };
+  static constexpr uint32_t Version = 2;
+
+  fs::path file;
+  std::unordered_map<std::wstring, size_t> byDir;
+
+  static uint64_t fnv1a(const char* p, size_t n) {
+    uint64_t h = 1469598103934665603ull;
+    for (size_t i = 0; i < n; ++i) {
+      h ^= static_cast<unsigned char>(p[i]);
+      h *= 1099511628211ull;
+    }
+    return h;
+  }
+
+  struct Writer {
+    std::string buf;
+    template<class T> void pod(T v) {
+      buf.append(reinterpret_cast<const char*>(&v), sizeof v);
+    }
+    void str(const std::wstring& s) {
+      pod(static_cast<uint32_t>(s.size()));
+      buf.append(reinterpret_cast<const char*>(s.data()), s.size() * sizeof(wchar_t));
+    }
+  };
+  struct Reader {
+    const char* p;
+    const char* end;
+    template<class T> bool pod(T& v) {
+      if (static_cast<size_t>(end - p) < sizeof v)return false;
+      std::memcpy(&v, p, sizeof v);
+      p += sizeof v;
+      return true;
+    }
+    bool str(std::wstring& s) {
+      uint32_t n;
+      if (!pod(n) || static_cast<size_t>(end - p) / sizeof(wchar_t) < n)return false;
+      s.resize(n);
+      std::memcpy(s.data(), p, n * sizeof(wchar_t));
+      p += n * sizeof(wchar_t);
+      return true;
+    }
+    bool path(fs::path& v) {
+      std::wstring s;
+      if (!str(s))return false;
+      v = s;
+      return true;
+    }
+  };
+public:
+  std::vector<DirStamp> walkedDirs;
+  std::vector<CatalogEntry> entries;
+
+  explicit CatalogIndex(fs::path file) : file(std::move(file)) {}
+
+  static bool stamp(const fs::path& metaFile, int64_t& mtime, uint64_t& size) {
+    std::error_code ec;
+    auto t = fs::last_write_time(metaFile, ec);
+    if (ec)return false;
+    auto s = fs::file_size(metaFile, ec);
+    if (ec)return false;
+    mtime = t.time_since_epoch().count();
+    size = s;
+    return true;
+  }
+
+  // Reads the whole index in one go. Returns false (leaving the index empty) if it is missing, corrupt or
+  // written for another root or build.
+  bool load(const fs::path& root) {
+    walkedDirs.clear();
+    entries.clear();
+    byDir.clear();
+    std::ifstream ifs(file, std::ios::binary | std::ios::ate);
+    if (!ifs.is_open())return false;
+    std::string buf(static_cast<size_t>(ifs.tellg()), '\0');
+    ifs.seekg(0);
+    if (!ifs.read(buf.data(), buf.size()))return false;
+
+    if (buf.size() < sizeof Magic + sizeof(uint64_t) || std::memcmp(buf.data(), Magic, sizeof Magic) != 0)return false;
+    uint64_t sum;
+    std::memcpy(&sum, buf.data() + buf.size() - sizeof sum, sizeof sum);
+    if (fnv1a(buf.data(), buf.size() - sizeof sum) != sum)return false;
+
+    Reader r{ buf.data() + sizeof Magic, buf.data() + buf.size() - sizeof sum };
+    uint32_t version, charSize, dirCount, entryCount;
+    fs::path storedRoot;
+    if (!r.pod(version) || version != Version)return false;
+    if (!r.pod(charSize) || charSize != sizeof(wchar_t))return false;
+    if (!r.path(storedRoot) || storedRoot != root)return false;
+
+    std::vector<DirStamp> dirs;
+    std::vector<CatalogEntry> list;
+    if (!r.pod(dirCount))return false;
+    for (uint32_t i = 0; i < dirCount; ++i) {
+      DirStamp d;
+      if (!r.path(d.path) || !r.pod(d.mtime))return false;
+      dirs.push_back(std::move(d));
+    }
+    if (!r.pod(entryCount))return false;
+    list.reserve(entryCount);
+    for (uint32_t i = 0; i < entryCount; ++i) {
+      CatalogEntry e;
+      uint8_t valid, movie;
+      int32_t difficulty;
+      if (!r.path(e.dir) || !r.pod(e.metaTime) || !r.pod(e.metaSize) || !r.pod(valid)
+        || !r.str(e.title) || !r.str(e.version) || !r.str(e.description)
+        || !r.path(e.executable) || !r.path(e.icon) || !r.path(e.detail)
+        || !r.pod(movie) || !r.pod(difficulty))
+        return false;
+      e.valid = valid != 0;
+      e.is_movie = movie != 0;
+      e.difficulty = difficulty;
+      list.push_back(std::move(e));
+    }
+    if (r.p != r.end)return false;
+    assign(std::move(dirs), std::move(list));
+    return true;
+  }
+
+  void assign(std::vector<DirStamp> dirs, std::vector<CatalogEntry> list) {
+    walkedDirs = std::move(dirs);
+    entries = std::move(list);
+    byDir.clear();
+    for (size_t i = 0; i < entries.size(); ++i)
+      byDir.emplace(entries[i].dir.wstring(), i);
+  }
+
+  // True if no game folder can have been added or removed since the index was written.
+  bool treeUnchanged() const {
+    if (walkedDirs.empty())return false;
+    for (const auto& d : walkedDirs) {
+      std::error_code ec;
+      auto t = fs::last_write_time(d.path, ec);
+      if (ec || t.time_since_epoch().count() != d.mtime)return false;
+    }
+    return true;
+  }
+
+  const CatalogEntry* find(const fs::path& dir, int64_t mtime, uint64_t size) const {
+    auto itr = byDir.find(dir.wstring());
+    if (itr == byDir.end())return nullptr;
+    const CatalogEntry& e = entries[itr->second];
+    return e.metaTime == mtime && e.metaSize == size ? &e : nullptr;
+  }
+
+  // Written to a temporary file first so that a crash mid-write never leaves a torn index behind.
+  bool save(const fs::path& root) const {
+    Writer w;
+    w.buf.append(Magic, sizeof Magic);
+    w.pod(Version);
+    w.pod(static_cast<uint32_t>(sizeof(wchar_t)));
+    w.str(root.wstring());
+    w.pod(static_cast<uint32_t>(walkedDirs.size()));
+    for (const auto& d : walkedDirs) {
+      w.str(d.path.wstring());
+      w.pod(d.mtime);
+    }
+    w.pod(static_cast<uint32_t>(entries.size()));
+    for (const auto& e : entries) {
+      w.str(e.dir.wstring());
+      w.pod(e.metaTime);
+      w.pod(e.metaSize);
+      w.pod(static_cast<uint8_t>(e.valid));
+      w.str(e.title);
+      w.str(e.version);
+      w.str(e.description);
+      w.str(e.executable.wstring());
+      w.str(e.icon.wstring());
+      w.str(e.detail.wstring());
+      w.pod(static_cast<uint8_t>(e.is_movie));
+      w.pod(static_cast<int32_t>(e.difficulty));
+    }
+    w.pod(fnv1a(w.buf.data(), w.buf.size()));
+
+    fs::path tmp = file;
+    tmp += ".tmp";
+    {
+      std::ofstream ofs(tmp, std::ios::binary | std::ios::trunc);
+      if (!ofs.is_open() || !ofs.write(w.buf.data(), w.buf.size()))return false;
+    }
+    std::error_code ec;
+    fs::rename(tmp, file, ec);
+    return !ec;
+  }
+};
@@ -0,0 +1,170 @@
+#pragma once
+#include <filesystem>
+#include <memory>
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <chrono>
+
+#include "Logger.h"
+#include "GameScanner.h"
+#include "CatalogIndex.h"
+#include "SettingsParser.h"
+#include "Catalog.h"
+#include "GamePack.h"
+#include "Trace.h"
+
+namespace fs = std::filesystem;
+
+// What LoadCatalog did and how long each step took.
+struct CatalogLoadStats {
+  bool warm = false;
+  size_t folders = 0;
+  size_t parsed = 0;
+  size_t valid = 0;
+  // Folder scan, or reading the index when the tree is unchanged.
+  long long scanUs = 0;
+  // Stat and parse of every settings.json.
+  long long parseUs = 0;
+  // Sorting and building the Catalog.
+  long long sortUs = 0;
+  long long saveUs = 0;
+};
+
+// dir may be a pack, whose settings.json is read from the head of the pack.
+inline bool ReadSettings(const fs::path& dir, CatalogEntry& entry, std::shared_ptr<Logger> logger) {
+  fs::path metaFile = dir / "settings.json";
+  entry.dir = dir;
+  entry.title = L"<ݒ>";
+  entry.version = L"s";
+  entry.description = L"<ݒ>";
+  entry.executable = dir / L"autorun.exe";
+  entry.icon = dir / L"image/unknown.png";
+  entry.detail = dir / L"image/unknown.png";
+  entry.is_movie = false;
+  entry.difficulty = -1;
+  SettingsError error;
+  bool parsed;
+  if (GamePack::isPack(dir)) {
+    thread_local std::string data;
+    parsed = GamePack::readSettings(dir, data) && SettingsParser::parse(data.data(), data.size(), dir, entry, error);
+  }
+  else parsed = SettingsParser::parseFile(metaFile, dir, entry, error);
+  if (!parsed) {
+    if (error.line == 0)
+      logger->err(
+        "Q[tH_ \"" + dir.string() + "\"̃t@C \""
+        + metaFile.filename().string() + "\"J܂łB"
+      );
+    else logger->info(metaFile.string() + " : " + error.str());
+    entry.valid = false;
+    return false;
+  }
+  entry.valid = true;
+  return true;
+}
+
+// Rebuilds the catalog from the on-disk index when possible. Folders are only rescanned if one of the
+// folders walked last time changed, and only settings.json files whose mtime or size changed are reparsed.
+// A pack is stamped with its own mtime and size, so an unchanged pack is not even opened.
+inline CatalogLoadStats LoadCatalog(const fs::path& gameDir, const fs::path& indexFile, Catalog& games, std::shared_ptr<Logger> logger) {
+  using clock = std::chrono::steady_clock;
+  auto us = [](clock::time_point from, clock::time_point to) {
+    return static_cast<long long>(std::chrono::duration_cast<std::chrono::microseconds>(to - from).count());
+  };
+  CatalogLoadStats stats;
+  auto start = clock::now();
+  CatalogIndex index(indexFile);
+
+  std::vector<fs::path> gameDirs;
+  std::vector<DirStamp> walkedDirs;
+  bool warm = index.load(gameDir) && index.treeUnchanged();
+  if (warm) {
+    for (const auto& e : index.entries)gameDirs.push_back(e.dir);
+    walkedDirs = index.walkedDirs;
+  }
+  else {
+    GameScanner scanner;
+    ScanResult scan = scanner.scan(gameDir);
+    for (const auto& dir : scan.errorDirs)
+      logger->err("tH_ \"" + dir.string() + "\"̓ǂݍݒɃG[܂B");
+    logger->info(
+      "Q[tH_̑F" + std::to_string(scan.gameDirs.size()) + "o, "
+      + std::to_string(scan.visitedDirs) + "tH_K, "
+      + std::to_string(scan.ignoredDirs) + "tH_O, "
+      + std::to_string(scan.elapsed.count()) + "us"
+    );
+    gameDirs = std::move(scan.gameDirs);
+    walkedDirs = std::move(scan.walkedDirs);
+  }
+  auto scanned = clock::now();
+
+  std::vector<CatalogEntry> entries;
+  entries.reserve(gameDirs.size());
+  size_t reparsed = 0;
+  bool dirty = !warm;
+  for (const auto& dir : gameDirs) {
+    CatalogEntry entry;
+    entry.dir = dir;
+    if (!CatalogIndex::stamp(GamePack::isPack(dir) ? dir : dir / "settings.json", entry.metaTime, entry.metaSize)) {
+      // Kept as an invalid entry so that the folder is checked again on the next start.
+      logger->err("Q[tH_ \"" + dir.string() + "\"̒Ƀt@C \"settings.json\"܂łB");
+      dirty = true;
+      entries.push_back(std::move(entry));
+      continue;
+    }
+    // An unchanged settings.json that failed to parse last time is not parsed again either.
+    const CatalogEntry* cached = index.find(dir, entry.metaTime, entry.metaSize);
+    if (cached) {
+      entry = *cached;
+      if (!entry.valid)logger->info("Q[tH_ \"" + dir.string() + "\"̐ݒ͑O񂩂ύXȂÂ܂܂łB");
+    }
+    else {
+      ++reparsed;
+      dirty = true;
+      ReadSettings(dir, entry, logger);
+    }
+    entries.push_back(std::move(entry));
+  }
+  auto parsed = clock::now();
+
+  // Unknown difficulty (-1) last. Stable, so that games of the same difficulty keep the catalog order.
+  std::vector<const CatalogEntry*> valid;
+  for (const auto& e : entries)
+    if (e.valid)valid.push_back(&e);
+  std::stable_sort(valid.begin(), valid.end(), [](const CatalogEntry* a, const CatalogEntry* b) {
+    if (a->difficulty == -1 || b->difficulty == -1)return a->difficulty != -1 && b->difficulty == -1;
+    return a->difficulty < b->difficulty;
+  });
+  games.clear();
+  games.reserve(valid.size());
+  for (const CatalogEntry* e : valid)games.add(*e);
+  auto sorted = clock::now();
+
+  stats.warm = warm;
+  stats.folders = entries.size();
+  stats.parsed = reparsed;
+  stats.valid = valid.size();
+  if (dirty) {
+    index.assign(std::move(walkedDirs), std::move(entries));
+    if (!index.save(gameDir))
+      logger->err("J^OCfbNX߂܂łB");
+  }
+  auto saved = clock::now();
+  stats.scanUs = us(start, scanned);
+  stats.parseUs = us(scanned, parsed);
+  stats.sortUs = us(parsed, sorted);
+  stats.saveUs = us(sorted, saved);
+  Trace::complete(warm ? "read index" : "scan", Trace::us(start), Trace::us(scanned));
+  Trace::complete("parse", Trace::us(scanned), Trace::us(parsed));
+  Trace::complete("sort", Trace::us(parsed), Trace::us(sorted));
+  if (dirty)Trace::complete("save index", Trace::us(sorted), Trace::us(saved));
+
+  logger->info(
+    std::string("J^Oǂݍ݁F") + (warm ? "CfbNXgp, " : "đ, ")
+    + std::to_string(stats.folders) + "" + std::to_string(reparsed) + ", "
+    + std::to_string(stats.scanUs) + "us, " + std::to_string(stats.parseUs) + "us, "
+    + std::to_string(stats.sortUs) + "us, ۑ" + std::to_string(stats.saveUs) + "us"
+  );
+  return stats;
+}
@@ -0,0 +1,163 @@
+#pragma once
+#include <filesystem>
+#include <memory>
+#include <string>
+#include <vector>
+#include <map>
+#include <set>
+#include <chrono>
+
+#include "Logger.h"
+#include "GameScanner.h"
+#include "CatalogLoader.h"
+#include "Catalog.h"
+#include "SearchIndex.h"
+#include "DirWatcher.h"
+#include "Trace.h"
+
+namespace fs = std::filesystem;
+
+// Keeps the catalog in step with Games/ while the launcher runs. For every path the DirWatcher reports,
+// only the settings.json of the game folder the path belongs to is read again, and that game is added,
+// updated or removed in the catalog and the search index in place. A new folder that holds no
+// settings.json itself is scanned for game folders below it. CatalogService, which does not search,
+// passes no search index.
+class CatalogReloader {
+public:
+  struct Stats {
+    size_t batches = 0;
+    size_t added = 0;
+    size_t updated = 0;
+    size_t removed = 0;
+    long long lastUs = 0;
+  };
+private:
+  fs::path root;
+  Catalog& games;
+  SearchIndex* search;
+  std::shared_ptr<Logger> logger;
+  ScanOptions scanOptions;
+  DirWatcher watcher;
+  // Game folder -> index in the catalog, removed games included.
+  std::map<std::wstring, uint32_t> known;
+  std::vector<fs::path> paths;
+  Stats counters;
+
+  // Depth below root; 0 for root itself and for anything outside it.
+  int depth(const fs::path& path) const {
+    fs::path rel = path.lexically_relative(root);
+    if (rel.empty() || *rel.begin() == "..")return 0;
+    int d = 0;
+    for (const auto& part : rel)
+      if (part != ".")++d;
+    return d;
+  }
+  bool isGame(const fs::path& dir) const {
+    std::error_code ec;
+    return fs::is_regular_file(GamePack::isPack(dir) ? dir : dir / scanOptions.metaFile, ec);
+  }
+  // Reads the game's settings.json again.
+  void check(const fs::path& dir, std::set<uint32_t>& changed) {
+    CatalogEntry entry;
+    bool valid = isGame(dir) && ReadSettings(dir, entry, logger);
+    auto itr = known.find(dir.wstring());
+    if (itr == known.end()) {
+      if (!valid)return;
+      uint32_t id = static_cast<uint32_t>(games.add(entry));
+      known.emplace(dir.wstring(), id);
+      changed.insert(id);
+      ++counters.added;
+      watcher.watch(dir);
+      logger->info("Q[ǉ܂F" + dir.string());
+    }
+    else if (valid) {
+      games.update(itr->second, entry);
+      changed.insert(itr->second);
+      ++counters.updated;
+    }
+    else if (!games.removed(itr->second)) {
+      games.remove(itr->second);
+      changed.insert(itr->second);
+      ++counters.removed;
+      logger->info("Q[폜܂F" + dir.string());
+    }
+  }
+  void apply(const fs::path& path, std::set<uint32_t>& changed) {
+    // A file or folder inside a known game, or the game folder itself.
+    bool inGame = false;
+    for (fs::path p = path; depth(p) > 0; p = p.parent_path()) {
+      if (known.count(p.wstring())) {
+        check(p, changed);
+        inGame = true;
+      }
+    }
+    // Known games below a folder that was renamed or deleted.
+    std::wstring prefix = (path / "").wstring();
+    std::vector<fs::path> below;
+    for (auto itr = known.lower_bound(prefix); itr != known.end() && itr->first.compare(0, prefix.size(), prefix) == 0; ++itr)
+      below.emplace_back(itr->first);
+    for (const auto& dir : below)check(dir, changed);
+    if (inGame)return;
+
+    // A game that is not in the catalog yet: the topmost folder on the way up that holds settings.json (or
+    // the pack itself), as GameScanner would find it.
+    std::error_code ec;
+    fs::path game;
+    for (fs::path p = fs::is_directory(path, ec) || GamePack::isPack(path) ? path : path.parent_path(); depth(p) > 0; p = p.parent_path())
+      if (depth(p) <= scanOptions.maxDepth && isGame(p))game = p;
+    if (!game.empty()) {
+      check(game, changed);
+      return;
+    }
+    int d = depth(path);
+    if (!fs::is_directory(path, ec) || d >= scanOptions.maxDepth)return;
+    ScanOptions options = scanOptions;
+    options.maxDepth -= d;
+    for (const auto& dir : GameScanner(options).scan(path).gameDirs)
+      if (!known.count(dir.wstring()) || games.removed(known[dir.wstring()]))check(dir, changed);
+    watcher.watch(path);
+  }
+public:
+  CatalogReloader(const fs::path& root, Catalog& games, SearchIndex* search, std::shared_ptr<Logger> logger,
+    std::chrono::milliseconds debounce = std::chrono::milliseconds(500), ScanOptions scanOptions = {})
+    : root(root), games(games), search(search), logger(logger), scanOptions(scanOptions)
+    , watcher(root, scanOptions.maxDepth + 1, [scanner = GameScanner(scanOptions)](const fs::path& dir) { return scanner.ignored(dir); }, debounce) {
+    for (size_t i = 0; i < games.size(); ++i)known.emplace(games.dir(i).wstring(), static_cast<uint32_t>(i));
+    if (!watcher.ok())logger->err("Q[tH_Ďł܂F" + root.string());
+  }
+  CatalogReloader(const CatalogReloader&) = delete;
+  CatalogReloader& operator=(const CatalogReloader&) = delete;
+
+  // Applies the changes that have settled. Returns true if games were added, changed or removed; changed
+  // then lists them, to be passed to Menu::refresh().
+  bool poll(std::vector<uint32_t>& changed) {
+    changed.clear();
+    bool overflow;
+    if (!watcher.poll(paths, overflow))return false;
+    TraceSpan span("reload");
+    auto start = std::chrono::steady_clock::now();
+    Stats before = counters;
+    std::set<uint32_t> ids;
+    if (overflow) {
+      logger->info("Q[tH_̕ύXǂ؂Ȃ߁AŜmF܂B");
+      apply(root, ids);
+    }
+    else
+      for (const auto& path : paths)apply(path, ids);
+    if (search)
+      for (uint32_t id : ids)search->update(games, id);
+    changed.assign(ids.begin(), ids.end());
+    ++counters.batches;
+    counters.lastUs = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start).count();
+    if (!changed.empty())
+      logger->info(
+        "Q[tH_̕ύX𔽉fFǉ" + std::to_string(counters.added - before.added) + ", XV"
+        + std::to_string(counters.updated - before.updated) + ", 폜" + std::to_string(counters.removed - before.removed)
+        + ", " + std::to_string(counters.lastUs) + "us"
+      );
+    return !changed.empty();
+  }
+  Stats stats() const {
+    return counters;
+  }
+};
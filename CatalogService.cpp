@@ -0,0 +1,79 @@
+// Scans and parses Games/ once for every launcher on the machine and publishes the catalog in shared
+// memory (CatalogService.h). Launchers started with --catalog-service=<name> map it instead of loading
+// the catalog themselves, and are told about changes to Games/ as the service picks them up.
+//
+//   g++ -std=c++17 -O2 -pthread -finput-charset=CP932 CatalogService.cpp -o catalog-service -lrt
+//   ./catalog-service [--games=DIR] [--name=launcher-catalog] [--index=FILE] [--log-level=info]
+//
+// --games is the Games/ folder the launchers use (./Games by default) and --index the catalog index kept
+// between runs (catalog.idx next to it). The service runs until interrupted and removes its socket and
+// shared memory on the way out.
+#include <iostream>
+#include <string>
+#include <string_view>
+#include <optional>
+#include <vector>
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <csignal>
+#include <cstdlib>
+
+#include "Logger.h"
+#include "Catalog.h"
+#include "CatalogLoader.h"
+#include "CatalogReloader.h"
+#include "CatalogService.h"
+
+std::atomic<bool> stopping{ false };
+
+std::optional<std::string_view> Option(int argc, char** argv, std::string_view name) {
+  for (int i = 1; i < argc; ++i) {
+    std::string_view arg = argv[i];
+    if (arg.substr(0, name.size()) == name)return arg.substr(name.size());
+  }
+  return std::nullopt;
+}
+
+int main(int argc, char** argv) {
+  auto logger = std::make_shared<Logger>(std::cerr);
+  if (auto value = Option(argc, argv, "--log-level=")) {
+    Logger::Level level;
+    if (Logger::parseLevel(*value, level))logger->setLevel(level);
+    else logger->err("sȃOxłF" + std::string(*value));
+  }
+  fs::path gameDir = fs::current_path() / "Games";
+  if (auto value = Option(argc, argv, "--games="))gameDir = fs::absolute(std::string(*value));
+  std::string name = "launcher-catalog";
+  if (auto value = Option(argc, argv, "--name="))name = std::string(*value);
+  fs::path indexFile = gameDir.parent_path() / "catalog.idx";
+  if (auto value = Option(argc, argv, "--index="))indexFile = std::string(*value);
+
+  CatalogService::Server server(name, logger);
+  if (!server.ok()) {
+    logger->close();
+    return EXIT_FAILURE;
+  }
+  Catalog games;
+  auto stats = LoadCatalog(gameDir, indexFile, games, logger);
+  logger->info(
+    "J^Oǂݍ݁F" + std::to_string(games.live()) + ", " + std::to_string(stats.scanUs + stats.parseUs + stats.sortUs) + "us"
+  );
+  if (!server.publish(games, {})) {
+    logger->close();
+    return EXIT_FAILURE;
+  }
+  CatalogReloader reloader(gameDir, games, nullptr, logger);
+
+  std::signal(SIGINT, [](int) { stopping = true; });
+  std::signal(SIGTERM, [](int) { stopping = true; });
+  std::vector<uint32_t> changed;
+  while (!stopping) {
+    server.poll();
+    if (reloader.poll(changed))server.publish(games, changed);
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+  }
+  logger->info("J^OT[rXI܂B");
+  logger->close();
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,516 @@
+#pragma once
+#include <filesystem>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+#include <set>
+#include <algorithm>
+#include <chrono>
+#include <thread>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <cerrno>
+
+#ifdef _WIN32
+// winsock2.h has to come before windows.h; Source.cpp includes it first for that reason.
+#include <winsock2.h>
+#include <afunix.h>
+#include <windows.h>
+#pragma comment(lib, "ws2_32.lib")
+#else
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+#include "Logger.h"
+#include "Catalog.h"
+#include "Trace.h"
+
+namespace fs = std::filesystem;
+
+// A catalog published by CatalogService and shared by every launcher on the machine. The service scans
+// and parses Games/, writes each version of the catalog once into its own named shared memory object
+// (CatalogImage) and tells the launchers connected to its local socket which games changed. A launcher
+// maps the newest object read-only and reads the catalog from it in place, so starting one more launcher
+// costs the same however many games there are, and the catalog is in memory once however many launchers
+// run.
+//
+// Each line the service sends is "catalog <generation> <object> <ids...>", with "*" instead of the ids
+// when every game may have changed: to a launcher that just connected, or after the service restarted.
+namespace CatalogService {
+
+inline std::string socketPath(const std::string& name) {
+  return (fs::temp_directory_path() / (name + ".sock")).string();
+}
+
+// A named shared memory object holding one catalog image. The service creates it and removes the name
+// when it is closed; launchers that still map it keep the memory until they unmap it.
+class SharedImage {
+  std::string object;
+#ifdef _WIN32
+  HANDLE mapping = NULL;
+#endif
+  const void* view = nullptr;
+  size_t length = 0;
+  bool owner = false;
+public:
+  SharedImage() = default;
+  SharedImage(const SharedImage&) = delete;
+  SharedImage& operator=(const SharedImage&) = delete;
+  ~SharedImage() {
+    close();
+  }
+  void swap(SharedImage& other) {
+    std::swap(object, other.object);
+#ifdef _WIN32
+    std::swap(mapping, other.mapping);
+#endif
+    std::swap(view, other.view);
+    std::swap(length, other.length);
+    std::swap(owner, other.owner);
+  }
+
+  bool create(const std::string& name, const std::vector<char>& data) {
+    close();
+#ifdef _WIN32
+    std::wstring wname = L"Local\\" + std::wstring(name.begin(), name.end());
+    uint64_t size = data.size();
+    mapping = CreateFileMappingW(INVALID_HANDLE_VALUE, NULL, PAGE_READWRITE, static_cast<DWORD>(size >> 32), static_cast<DWORD>(size), wname.c_str());
+    if (mapping == NULL)return false;
+    void* p = MapViewOfFile(mapping, FILE_MAP_ALL_ACCESS, 0, 0, data.size());
+    if (!p) {
+      close();
+      return false;
+    }
+    std::memcpy(p, data.data(), data.size());
+    UnmapViewOfFile(p);
+#else
+    std::string shm = "/" + name;
+    shm_unlink(shm.c_str());
+    int fd = shm_open(shm.c_str(), O_CREAT | O_EXCL | O_RDWR | O_CLOEXEC, 0644);
+    if (fd < 0)return false;
+    bool written = ftruncate(fd, static_cast<off_t>(data.size())) == 0;
+    for (size_t done = 0; written && done < data.size();) {
+      ssize_t n = pwrite(fd, data.data() + done, data.size() - done, static_cast<off_t>(done));
+      if (n <= 0)written = false;
+      else done += static_cast<size_t>(n);
+    }
+    ::close(fd);
+    if (!written) {
+      shm_unlink(shm.c_str());
+      return false;
+    }
+#endif
+    object = name;
+    length = data.size();
+    owner = true;
+    return true;
+  }
+  bool open(const std::string& name) {
+    close();
+#ifdef _WIN32
+    std::wstring wname = L"Local\\" + std::wstring(name.begin(), name.end());
+    HANDLE h = OpenFileMappingW(FILE_MAP_READ, FALSE, wname.c_str());
+    if (h == NULL)return false;
+    view = MapViewOfFile(h, FILE_MAP_READ, 0, 0, 0);
+    // The view keeps the object alive.
+    CloseHandle(h);
+    MEMORY_BASIC_INFORMATION info;
+    if (view && VirtualQuery(view, &info, sizeof(info)) != 0)length = info.RegionSize;
+#else
+    int fd = shm_open(("/" + name).c_str(), O_RDONLY | O_CLOEXEC, 0);
+    if (fd < 0)return false;
+    struct stat st;
+    if (fstat(fd, &st) == 0 && st.st_size > 0) {
+      void* p = mmap(nullptr, static_cast<size_t>(st.st_size), PROT_READ, MAP_SHARED, fd, 0);
+      if (p != MAP_FAILED) {
+        view = p;
+        length = static_cast<size_t>(st.st_size);
+      }
+    }
+    ::close(fd);
+#endif
+    if (!view) {
+      close();
+      return false;
+    }
+    object = name;
+    return true;
+  }
+  void close() {
+#ifdef _WIN32
+    if (view)UnmapViewOfFile(view);
+    if (mapping != NULL)CloseHandle(mapping);
+    mapping = NULL;
+#else
+    if (view)munmap(const_cast<void*>(view), length);
+    if (owner && !object.empty())shm_unlink(("/" + object).c_str());
+#endif
+    view = nullptr;
+    length = 0;
+    owner = false;
+    object.clear();
+  }
+  const void* data() const {
+    return view;
+  }
+  size_t size() const {
+    return length;
+  }
+  const std::string& name() const {
+    return object;
+  }
+};
+
+// Non-blocking Unix domain socket; AF_UNIX is also available on Windows 10.
+class LocalSocket {
+#ifdef _WIN32
+  SOCKET fd = INVALID_SOCKET;
+  static bool valid(SOCKET s) {
+    return s != INVALID_SOCKET;
+  }
+  static bool wouldBlock() {
+    return WSAGetLastError() == WSAEWOULDBLOCK;
+  }
+  static bool startup() {
+    static bool started = [] {
+      WSADATA data;
+      return WSAStartup(MAKEWORD(2, 2), &data) == 0;
+    }();
+    return started;
+  }
+#else
+  int fd = -1;
+  static bool valid(int s) {
+    return s >= 0;
+  }
+  static bool wouldBlock() {
+    return errno == EAGAIN || errno == EWOULDBLOCK;
+  }
+  static bool startup() {
+    return true;
+  }
+#endif
+  bool nonBlocking() {
+#ifdef _WIN32
+    u_long on = 1;
+    return ioctlsocket(fd, FIONBIO, &on) == 0;
+#else
+    return fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK) == 0;
+#endif
+  }
+  bool make(sockaddr_un& addr, const std::string& path) {
+    if (!startup() || path.size() >= sizeof(addr.sun_path))return false;
+    std::memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    std::memcpy(addr.sun_path, path.c_str(), path.size());
+    fd = ::socket(AF_UNIX, SOCK_STREAM, 0);
+    return valid(fd);
+  }
+public:
+  LocalSocket() = default;
+  LocalSocket(LocalSocket&& other) noexcept : fd(other.fd) {
+    other.fd = decltype(fd)(-1);
+  }
+  LocalSocket& operator=(LocalSocket&& other) noexcept {
+    std::swap(fd, other.fd);
+    return *this;
+  }
+  ~LocalSocket() {
+    close();
+  }
+  bool isOpen() const {
+    return valid(fd);
+  }
+  void close() {
+#ifdef _WIN32
+    if (valid(fd))closesocket(fd);
+#else
+    if (valid(fd))::close(fd);
+#endif
+    fd = decltype(fd)(-1);
+  }
+
+  bool listen(const std::string& path) {
+    close();
+    sockaddr_un addr;
+    if (!make(addr, path))return false;
+    if (::bind(fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) != 0 || ::listen(fd, 64) != 0 || !nonBlocking()) {
+      close();
+      return false;
+    }
+    return true;
+  }
+  // Blocks until connected, which is immediate for a local socket.
+  bool connect(const std::string& path) {
+    close();
+    sockaddr_un addr;
+    if (!make(addr, path))return false;
+    if (::connect(fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) != 0 || !nonBlocking()) {
+      close();
+      return false;
+    }
+    return true;
+  }
+  // An invalid socket if nobody is waiting.
+  LocalSocket accept() {
+    LocalSocket client;
+    client.fd = ::accept(fd, nullptr, nullptr);
+    if (client.isOpen() && !client.nonBlocking())client.close();
+    return client;
+  }
+  // Messages are short; a peer that cannot take one right away is treated as gone.
+  bool send(std::string_view data) {
+    while (!data.empty()) {
+#ifdef _WIN32
+      int n = ::send(fd, data.data(), static_cast<int>(data.size()), 0);
+#else
+      ssize_t n = ::send(fd, data.data(), data.size(), MSG_NOSIGNAL);
+#endif
+      if (n <= 0)return false;
+      data.remove_prefix(static_cast<size_t>(n));
+    }
+    return true;
+  }
+  // Appends what has arrived. Returns false once the peer closed the connection.
+  bool receive(std::string& buffer) {
+    char chunk[4096];
+    for (;;) {
+#ifdef _WIN32
+      int n = ::recv(fd, chunk, static_cast<int>(sizeof(chunk)), 0);
+#else
+      ssize_t n = ::recv(fd, chunk, sizeof(chunk), 0);
+#endif
+      if (n > 0)buffer.append(chunk, static_cast<size_t>(n));
+      else if (n < 0 && wouldBlock())return true;
+      else return false;
+    }
+  }
+};
+
+// Owned by the service process. The previous image is kept until the next one is published, so that a
+// launcher told about it just before has time to map it.
+class Server {
+  std::string name;
+  std::string path;
+  std::shared_ptr<Logger> logger;
+  LocalSocket listener;
+  std::vector<LocalSocket> clients;
+  SharedImage current, previous;
+  uint64_t generation = 0;
+  std::vector<char> buffer;
+  std::string line;
+
+  void broadcast() {
+    for (size_t i = 0; i < clients.size();) {
+      if (clients[i].send(line))++i;
+      else {
+        clients[i] = std::move(clients.back());
+        clients.pop_back();
+      }
+    }
+  }
+public:
+  Server(const std::string& name, std::shared_ptr<Logger> logger) : name(name), path(socketPath(name)), logger(logger) {
+    // A socket file left by a service that did not exit cleanly is removed; one that still answers is not.
+    LocalSocket probe;
+    if (probe.connect(path)) {
+      logger->err("J^OT[rX͊ɓ삵Ă܂F" + name);
+      return;
+    }
+    std::error_code ec;
+    fs::remove(path, ec);
+    if (!listener.listen(path))logger->err("J^OT[rX̃\PbgJ܂łF" + path);
+  }
+  Server(const Server&) = delete;
+  Server& operator=(const Server&) = delete;
+  ~Server() {
+    if (!listener.isOpen())return;
+    listener.close();
+    std::error_code ec;
+    fs::remove(path, ec);
+  }
+  bool ok() const {
+    return listener.isOpen();
+  }
+
+  // Publishes a new version of the catalog; changed lists the games that differ from the previous one,
+  // and is empty if any game may have.
+  bool publish(const Catalog& games, const std::vector<uint32_t>& changed) {
+    TraceSpan span("publish");
+    auto start = std::chrono::steady_clock::now();
+    games.writeImage(buffer, generation + 1);
+    // The process id keeps the objects of a restarted service apart from those launchers still map.
+#ifdef _WIN32
+    unsigned long pid = GetCurrentProcessId();
+#else
+    unsigned long pid = static_cast<unsigned long>(getpid());
+#endif
+    std::string object = name + "." + std::to_string(pid) + "." + std::to_string(generation + 1);
+    SharedImage next;
+    if (!next.create(object, buffer)) {
+      logger->err("J^OLɏ߂܂łF" + object);
+      return false;
+    }
+    ++generation;
+    previous.swap(current);
+    current.swap(next);
+    line = "catalog " + std::to_string(generation) + " " + object;
+    if (changed.empty())line += " *";
+    for (uint32_t id : changed)line += " " + std::to_string(id);
+    line += "\n";
+    broadcast();
+    logger->info(
+      "J^OJF" + std::to_string(generation) + ", " + std::to_string(games.size()) + ", "
+      + std::to_string(buffer.size() / 1024) + "KB, ڑ" + std::to_string(clients.size()) + ", "
+      + std::to_string(std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start).count()) + "us"
+    );
+    return true;
+  }
+  // Accepts launchers that connected and forgets those that went away.
+  void poll() {
+    for (LocalSocket client = listener.accept(); client.isOpen(); client = listener.accept()) {
+      if (generation > 0 && !client.send("catalog " + std::to_string(generation) + " " + current.name() + " *\n"))continue;
+      clients.push_back(std::move(client));
+    }
+    std::string ignored;
+    for (size_t i = 0; i < clients.size();) {
+      ignored.clear();
+      if (clients[i].receive(ignored))++i;
+      else {
+        clients[i] = std::move(clients.back());
+        clients.pop_back();
+      }
+    }
+  }
+  size_t connections() const {
+    return clients.size();
+  }
+  uint64_t version() const {
+    return generation;
+  }
+};
+
+// Used by a launcher in place of LoadCatalog and CatalogReloader. The catalog passed in is attached to
+// the newest image and must not be changed by anything else.
+class Client {
+public:
+  struct Stats {
+    uint64_t generation = 0;
+    size_t updates = 0;
+    size_t reconnects = 0;
+    long long attachUs = 0;
+  };
+private:
+  std::string path;
+  std::shared_ptr<Logger> logger;
+  LocalSocket socket;
+  std::string input;
+  std::vector<std::string> tokens;
+  SharedImage current, next;
+  // What the lines received so far ask for.
+  std::string object;
+  uint64_t generation = 0;
+  std::set<uint32_t> ids;
+  bool all = false;
+  std::chrono::steady_clock::time_point retryAt;
+  Stats counters;
+
+  void read() {
+    if (!socket.isOpen()) {
+      if (std::chrono::steady_clock::now() < retryAt)return;
+      retryAt = std::chrono::steady_clock::now() + std::chrono::seconds(2);
+      if (!socket.connect(path))return;
+      ++counters.reconnects;
+      input.clear();
+    }
+    if (!socket.receive(input)) {
+      logger->err("J^OT[rXƂ̐ڑ؂܂B");
+      socket.close();
+    }
+    size_t begin = 0;
+    for (size_t end; (end = input.find('\n', begin)) != std::string::npos; begin = end + 1) {
+      std::string_view l(input.data() + begin, end - begin);
+      tokens.clear();
+      for (size_t p = 0; p < l.size();) {
+        size_t q = std::min(l.find(' ', p), l.size());
+        if (q > p)tokens.emplace_back(l.substr(p, q - p));
+        p = q + 1;
+      }
+      // The object already attached shows up again after reconnecting to the same service.
+      if (tokens.size() < 3 || tokens[0] != "catalog" || tokens[2] == current.name())continue;
+      generation = std::strtoull(tokens[1].c_str(), nullptr, 10);
+      object = tokens[2];
+      for (size_t i = 3; i < tokens.size(); ++i) {
+        if (tokens[i] == "*")all = true;
+        else ids.insert(static_cast<uint32_t>(std::strtoul(tokens[i].c_str(), nullptr, 10)));
+      }
+    }
+    input.erase(0, begin);
+  }
+  bool attach(Catalog& games) {
+    TraceSpan span("attach catalog");
+    auto start = std::chrono::steady_clock::now();
+    if (!next.open(object) || !games.attach(next.data(), next.size())) {
+      logger->err("LJ^OJ܂łF" + object);
+      next.close();
+      object.clear();
+      // Connecting again brings the newest image.
+      socket.close();
+      all = true;
+      return false;
+    }
+    current.swap(next);
+    next.close();
+    object.clear();
+    counters.generation = generation;
+    counters.attachUs = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start).count();
+    return true;
+  }
+public:
+  Client(const std::string& name, std::shared_ptr<Logger> logger) : path(socketPath(name)), logger(logger) {}
+  Client(const Client&) = delete;
+  Client& operator=(const Client&) = delete;
+
+  // Waits for the first image. The catalog stays as it was if none arrives in time.
+  bool load(Catalog& games, std::chrono::milliseconds timeout) {
+    auto deadline = std::chrono::steady_clock::now() + timeout;
+    do {
+      retryAt = {};
+      read();
+      if (!object.empty() && attach(games)) {
+        ids.clear();
+        all = false;
+        return true;
+      }
+      std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    } while (std::chrono::steady_clock::now() < deadline);
+    return false;
+  }
+  // Attaches the catalog to a newer image if one was published. Returns true if it was; changed then
+  // lists the games that changed, to be passed to SearchIndex::update() and Menu::refresh(), unless
+  // every index may have changed (everything is set), in which case they have to be rebuilt.
+  bool poll(Catalog& games, std::vector<uint32_t>& changed, bool& everything) {
+    changed.clear();
+    everything = false;
+    read();
+    if (object.empty() || !attach(games))return false;
+    ++counters.updates;
+    everything = all;
+    if (!all)changed.assign(ids.begin(), ids.end());
+    ids.clear();
+    all = false;
+    return true;
+  }
+  Stats stats() const {
+    return counters;
+  }
+};
+
+}
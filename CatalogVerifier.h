@@ -0,0 +1,585 @@
+#pragma once
+#include <filesystem>
+#include <fstream>
+#include <memory>
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <chrono>
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <cstdio>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+#include "Logger.h"
+#include "GameScanner.h"
+#include "CatalogIndex.h"
+#include "CatalogLoader.h"
+#include "GamePack.h"
+#include "ThreadPool.h"
+#include "Trace.h"
+
+namespace fs = std::filesystem;
+
+// 64-bit xxHash (XXH64) of data fed in pieces. Not cryptographic; it only has to notice files that
+// changed, at the speed the disk delivers them.
+class ContentHash {
+  static constexpr uint64_t P1 = 11400714785074694791ull;
+  static constexpr uint64_t P2 = 14029467366897019727ull;
+  static constexpr uint64_t P3 = 1609587929392839161ull;
+  static constexpr uint64_t P4 = 9650029242287828579ull;
+  static constexpr uint64_t P5 = 2870177450012600261ull;
+  uint64_t seed;
+  uint64_t v[4];
+  uint64_t total = 0;
+  unsigned char tail[32];
+  size_t tailSize = 0;
+
+  static uint64_t rotl(uint64_t x, int r) {
+    return x << r | x >> (64 - r);
+  }
+  static uint64_t read64(const unsigned char* p) {
+    uint64_t x;
+    std::memcpy(&x, p, sizeof(x));
+    return x;
+  }
+  static uint32_t read32(const unsigned char* p) {
+    uint32_t x;
+    std::memcpy(&x, p, sizeof(x));
+    return x;
+  }
+  static uint64_t round(uint64_t acc, uint64_t input) {
+    return rotl(acc + input * P2, 31) * P1;
+  }
+  static uint64_t merge(uint64_t acc, uint64_t val) {
+    return (acc ^ round(0, val)) * P1 + P4;
+  }
+  void stripes(const unsigned char* p, size_t n) {
+    for (const unsigned char* end = p + n; p < end; p += 32) {
+      v[0] = round(v[0], read64(p));
+      v[1] = round(v[1], read64(p + 8));
+      v[2] = round(v[2], read64(p + 16));
+      v[3] = round(v[3], read64(p + 24));
+    }
+  }
+public:
+  explicit ContentHash(uint64_t seed = 0) : seed(seed), v{ seed + P1 + P2, seed + P2, seed, seed - P1 } {}
+
+  void update(const void* data, size_t n) {
+    auto p = static_cast<const unsigned char*>(data);
+    total += n;
+    if (tailSize + n < 32) {
+      std::memcpy(tail + tailSize, p, n);
+      tailSize += n;
+      return;
+    }
+    if (tailSize > 0) {
+      size_t fill = 32 - tailSize;
+      std::memcpy(tail + tailSize, p, fill);
+      stripes(tail, 32);
+      p += fill;
+      n -= fill;
+      tailSize = 0;
+    }
+    size_t whole = n / 32 * 32;
+    stripes(p, whole);
+    tailSize = n - whole;
+    std::memcpy(tail, p + whole, tailSize);
+  }
+  uint64_t digest() const {
+    uint64_t h = total >= 32
+      ? merge(merge(merge(merge(rotl(v[0], 1) + rotl(v[1], 7) + rotl(v[2], 12) + rotl(v[3], 18), v[0]), v[1]), v[2]), v[3])
+      : seed + P5;
+    h += total;
+    const unsigned char* p = tail;
+    const unsigned char* end = tail + tailSize;
+    for (; p + 8 <= end; p += 8)h = rotl(h ^ round(0, read64(p)), 27) * P1 + P4;
+    if (p + 4 <= end) {
+      h = rotl(h ^ read32(p) * P1, 23) * P2 + P3;
+      p += 4;
+    }
+    for (; p < end; ++p)h = rotl(h ^ *p * P5, 11) * P1;
+    h ^= h >> 33;
+    h *= P2;
+    h ^= h >> 29;
+    h *= P3;
+    h ^= h >> 32;
+    return h;
+  }
+};
+
+// Checks every game under Games/ before a visitor finds it broken: settings.json must parse, the
+// executable must exist and look like a program (Launch() would fail with InvalidPathError or
+// CreateProcessError otherwise) and the icon and detail image must exist. Optionally every file of
+// every game is hashed, so that a copy that changed or got corrupted shows up as a changed folder hash.
+// Games are checked in parallel on a thread pool; at most ioSlots files are read at a time. Hashes are
+// cached by path, mtime and size in cacheFile, so a rerun only reads files that changed. A packed game is
+// checked inside its pack, and the pack is hashed as a whole.
+class CatalogVerifier {
+public:
+  enum Problem : uint32_t {
+    SettingsInvalid = 1,
+    ExecutableMissing = 2,
+    ExecutableInvalid = 4,
+    IconMissing = 8,
+    DetailMissing = 16,
+    Unreadable = 32
+  };
+  struct Options {
+    size_t threads = 0;
+    size_t ioSlots = 4;
+    bool hash = true;
+    size_t chunk = 1 << 20;
+  };
+  struct Game {
+    fs::path dir;
+    std::wstring title;
+    uint32_t problems = 0;
+    size_t files = 0;
+    uint64_t bytes = 0;
+    // Of every file's relative path, size and content; 0 without hashing.
+    uint64_t hash = 0;
+    // The hash differs from the last run's.
+    bool changed = false;
+  };
+  struct Report {
+    fs::path root;
+    std::vector<Game> games;
+    size_t files = 0;
+    uint64_t bytes = 0;
+    size_t hashedFiles = 0;
+    uint64_t hashedBytes = 0;
+    long long elapsedMs = 0;
+
+    size_t broken() const {
+      return std::count_if(games.begin(), games.end(), [](const Game& g) { return g.problems != 0; });
+    }
+    static std::vector<const char*> problemNames(uint32_t problems) {
+      static const char* const names[] = {
+        "settings_invalid", "executable_missing", "executable_invalid", "icon_missing", "detail_missing", "unreadable"
+      };
+      std::vector<const char*> out;
+      for (int bit = 0; bit < 6; ++bit)
+        if (problems & 1u << bit)out.push_back(names[bit]);
+      return out;
+    }
+    // UTF-8 JSON.
+    std::string json() const {
+      char hex[17];
+      std::string out = "{\n  \"root\": \"" + escape(root.wstring()) + "\",\n"
+        + "  \"games\": " + std::to_string(games.size()) + ",\n"
+        + "  \"broken\": " + std::to_string(broken()) + ",\n"
+        + "  \"files\": " + std::to_string(files) + ",\n"
+        + "  \"bytes\": " + std::to_string(bytes) + ",\n"
+        + "  \"hashed_files\": " + std::to_string(hashedFiles) + ",\n"
+        + "  \"hashed_bytes\": " + std::to_string(hashedBytes) + ",\n"
+        + "  \"elapsed_ms\": " + std::to_string(elapsedMs) + ",\n"
+        + "  \"results\": [";
+      for (size_t i = 0; i < games.size(); ++i) {
+        const Game& g = games[i];
+        snprintf(hex, sizeof(hex), "%016llx", static_cast<unsigned long long>(g.hash));
+        out += std::string(i ? "," : "") + "\n    {\"dir\": \"" + escape(g.dir.wstring()) + "\", \"title\": \"" + escape(g.title)
+          + "\", \"status\": \"" + (g.problems ? "broken" : "ok") + "\", \"problems\": [";
+        auto names = problemNames(g.problems);
+        for (size_t k = 0; k < names.size(); ++k)out += std::string(k ? ", " : "") + "\"" + names[k] + "\"";
+        out += "], \"files\": " + std::to_string(g.files) + ", \"bytes\": " + std::to_string(g.bytes)
+          + ", \"hash\": \"" + hex + "\", \"changed\": " + (g.changed ? "true" : "false") + "}";
+      }
+      out += "\n  ]\n}\n";
+      return out;
+    }
+    bool write(const fs::path& file) const {
+      std::ofstream ofs(file, std::ios::binary | std::ios::trunc);
+      std::string s = json();
+      return ofs.is_open() && ofs.write(s.data(), s.size());
+    }
+  };
+private:
+  static constexpr char Magic[4] = { 'L', 'V', 'R', 'F' };
+  static constexpr uint32_t Version = 1;
+  struct Cached {
+    std::wstring_view rel;
+    int64_t mtime;
+    uint64_t size;
+    uint64_t hash;
+  };
+  struct CachedDir {
+    uint64_t hash;
+    // Sorted by rel.
+    std::vector<Cached> files;
+  };
+  struct File {
+    std::wstring rel;
+    int64_t mtime = 0;
+    uint64_t size = 0;
+    uint64_t hash = 0;
+    bool ok = true;
+  };
+
+  fs::path cacheFile;
+  std::shared_ptr<Logger> logger;
+  Options opt;
+  // What the last run saw, by game folder, viewing into the file's contents; read-only while the checks
+  // run.
+  std::string cache;
+  std::unordered_map<std::wstring_view, CachedDir> cachedDirs;
+
+  std::mutex slotMtx;
+  std::condition_variable slotCv;
+  size_t slotsUsed = 0;
+  std::atomic<size_t> hashedFiles{ 0 };
+  std::atomic<uint64_t> hashedBytes{ 0 };
+
+  static std::string escape(const std::wstring& s) {
+    std::string out;
+    for (size_t i = 0; i < s.size(); ++i) {
+      char32_t c = static_cast<char32_t>(s[i]);
+      if (0xd800 <= c && c < 0xdc00 && i + 1 < s.size()) {
+        c = 0x10000 + ((c - 0xd800) << 10) + (static_cast<char32_t>(s[i + 1]) - 0xdc00);
+        ++i;
+      }
+      if (c == '"' || c == '\\') {
+        out += '\\';
+        out += static_cast<char>(c);
+      }
+      else if (c < 0x20) {
+        char buf[8];
+        snprintf(buf, sizeof(buf), "\\u%04x", static_cast<unsigned>(c));
+        out += buf;
+      }
+      else if (c < 0x80)out += static_cast<char>(c);
+      else if (c < 0x800) {
+        out += static_cast<char>(0xc0 | c >> 6);
+        out += static_cast<char>(0x80 | (c & 0x3f));
+      }
+      else if (c < 0x10000) {
+        out += static_cast<char>(0xe0 | c >> 12);
+        out += static_cast<char>(0x80 | (c >> 6 & 0x3f));
+        out += static_cast<char>(0x80 | (c & 0x3f));
+      }
+      else {
+        out += static_cast<char>(0xf0 | c >> 18);
+        out += static_cast<char>(0x80 | (c >> 12 & 0x3f));
+        out += static_cast<char>(0x80 | (c >> 6 & 0x3f));
+        out += static_cast<char>(0x80 | (c & 0x3f));
+      }
+    }
+    return out;
+  }
+
+  struct Slot {
+    CatalogVerifier& v;
+    explicit Slot(CatalogVerifier& v) : v(v) {
+      std::unique_lock<std::mutex> lock(v.slotMtx);
+      v.slotCv.wait(lock, [&] { return v.slotsUsed < std::max<size_t>(v.opt.ioSlots, 1); });
+      ++v.slotsUsed;
+    }
+    ~Slot() {
+      {
+        std::lock_guard<std::mutex> lock(v.slotMtx);
+        --v.slotsUsed;
+      }
+      v.slotCv.notify_one();
+    }
+  };
+  // Reads up to n bytes from the start of the file, or all of it into the hash if hash is given. Returns
+  // false if the file could not be read to the end.
+  bool read(const fs::path& file, uint64_t size, ContentHash* hash, char* head, size_t n, std::vector<char>& buf) {
+    Slot slot(*this);
+#ifdef _WIN32
+    HANDLE h = CreateFileW(file.c_str(), GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE,
+      NULL, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+    if (h == INVALID_HANDLE_VALUE)return false;
+#else
+    int fd = ::open(file.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0)return false;
+    posix_fadvise(fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+#endif
+    uint64_t want = hash ? size : std::min<uint64_t>(n, size);
+    uint64_t done = 0;
+    while (done < want) {
+      size_t len = static_cast<size_t>(std::min<uint64_t>(buf.size(), want - done));
+#ifdef _WIN32
+      DWORD got = 0;
+      if (!ReadFile(h, buf.data(), static_cast<DWORD>(len), &got, NULL) || got == 0)break;
+#else
+      ssize_t got = ::read(fd, buf.data(), len);
+      if (got <= 0)break;
+#endif
+      if (done < n)std::memcpy(head + done, buf.data(), std::min<size_t>(static_cast<size_t>(got), static_cast<size_t>(n - done)));
+      if (hash)hash->update(buf.data(), static_cast<size_t>(got));
+      done += static_cast<uint64_t>(got);
+    }
+#ifdef _WIN32
+    CloseHandle(h);
+#else
+    ::close(fd);
+#endif
+    return done == want;
+  }
+  void hashFile(const fs::path& dir, File& f) {
+    thread_local std::vector<char> buf;
+    buf.resize(opt.chunk);
+    ContentHash h;
+    f.ok = read(dir / f.rel, f.size, &h, nullptr, 0, buf);
+    f.hash = h.digest();
+    hashedFiles.fetch_add(1, std::memory_order_relaxed);
+    hashedBytes.fetch_add(f.size, std::memory_order_relaxed);
+  }
+  // The files of a packed game are looked up in the pack; a pack made without its payload runs the
+  // executable from the folder it was made from.
+  void checkPack(Game& game, const CatalogEntry& entry) {
+    GamePack pack;
+    if (!pack.open(game.dir)) {
+      game.problems |= Unreadable;
+      return;
+    }
+    auto find = [&pack](const fs::path& path, std::string_view& data) {
+      fs::path file;
+      std::string name;
+      return GamePack::split(path, file, name) && pack.find(name, data);
+    };
+    std::string_view data;
+    if (pack.payload()) {
+      if (!find(entry.executable, data))game.problems |= ExecutableMissing;
+      else if (data.size() < 2 || data[0] != 'M' || data[1] != 'Z')game.problems |= ExecutableInvalid;
+    }
+    else {
+      std::error_code ec;
+      if (!fs::is_regular_file(pack.source() / entry.executable.lexically_relative(game.dir), ec))game.problems |= ExecutableMissing;
+    }
+    if (!find(entry.icon, data))game.problems |= IconMissing;
+    if (!find(entry.detail, data))game.problems |= DetailMissing;
+  }
+  void check(ThreadPool& pool, Game& game, std::vector<File>& files) {
+    CatalogEntry entry;
+    if (!ReadSettings(game.dir, entry, logger)) {
+      game.problems |= SettingsInvalid;
+    }
+    else if (GamePack::isPack(game.dir)) {
+      game.title = entry.title;
+      checkPack(game, entry);
+    }
+    else {
+      game.title = entry.title;
+      std::error_code ec;
+      // The same test as ProcessSupervisor::start().
+      if (!fs::is_regular_file(entry.executable, ec))game.problems |= ExecutableMissing;
+      else {
+        uint64_t size = fs::file_size(entry.executable, ec);
+        // Everything CreateProcess runs starts with the DOS header.
+        thread_local std::vector<char> buf(4096);
+        char head[2] = {};
+        if (size < 2 || !read(entry.executable, size, nullptr, head, sizeof(head), buf) || head[0] != 'M' || head[1] != 'Z')
+          game.problems |= ExecutableInvalid;
+      }
+      if (!fs::is_regular_file(entry.icon, ec))game.problems |= IconMissing;
+      if (!fs::is_regular_file(entry.detail, ec))game.problems |= DetailMissing;
+    }
+    if (!opt.hash)return;
+    std::error_code ec;
+    fs::path base = game.dir;
+    if (GamePack::isPack(game.dir)) {
+      base = game.dir.parent_path();
+      File f;
+      f.rel = game.dir.filename().wstring();
+      f.size = fs::file_size(game.dir, ec);
+      if (!ec)f.mtime = fs::last_write_time(game.dir, ec).time_since_epoch().count();
+      if (ec)f.ok = false;
+      files.push_back(std::move(f));
+    }
+    else {
+      for (fs::recursive_directory_iterator itr(game.dir, fs::directory_options::skip_permission_denied, ec), end;
+        !ec && itr != end; itr.increment(ec)) {
+        std::error_code fileEc;
+        if (!itr->is_regular_file(fileEc))continue;
+        File f;
+        f.rel = itr->path().lexically_relative(game.dir).generic_wstring();
+        f.size = itr->file_size(fileEc);
+        if (!fileEc)f.mtime = itr->last_write_time(fileEc).time_since_epoch().count();
+        if (fileEc)f.ok = false;
+        files.push_back(std::move(f));
+      }
+      if (ec)game.problems |= Unreadable;
+    }
+    std::sort(files.begin(), files.end(), [](const File& a, const File& b) { return a.rel < b.rel; });
+    auto dir = cachedDirs.find(game.dir.wstring());
+    for (File& f : files) {
+      if (!f.ok)continue;
+      if (dir != cachedDirs.end()) {
+        auto& list = dir->second.files;
+        auto c = std::lower_bound(list.begin(), list.end(), f.rel, [](const Cached& c, const std::wstring& rel) { return c.rel < rel; });
+        if (c != list.end() && c->rel == f.rel && c->mtime == f.mtime && c->size == f.size) {
+          f.hash = c->hash;
+          continue;
+        }
+      }
+      pool.post([this, base, &f] { hashFile(base, f); });
+    }
+  }
+  // The folder hash, once all files are hashed.
+  void finish(Game& game, std::vector<File>& files) {
+    if (!opt.hash)return;
+    ContentHash h;
+    for (const File& f : files) {
+      if (!f.ok)game.problems |= Unreadable;
+      h.update(f.rel.data(), f.rel.size() * sizeof(wchar_t));
+      h.update(&f.size, sizeof(f.size));
+      h.update(&f.hash, sizeof(f.hash));
+      game.bytes += f.size;
+    }
+    game.files = files.size();
+    game.hash = h.digest();
+    auto cached = cachedDirs.find(game.dir.wstring());
+    game.changed = cached != cachedDirs.end() && cached->second.hash != game.hash;
+  }
+
+  template<class T> static bool get(const char*& p, const char* end, T& v) {
+    if (static_cast<size_t>(end - p) < sizeof(v))return false;
+    std::memcpy(&v, p, sizeof(v));
+    p += sizeof(v);
+    return true;
+  }
+  static bool text(const char*& p, const char* end, std::wstring_view& s) {
+    uint32_t n;
+    if (!get(p, end, n) || static_cast<size_t>(end - p) / sizeof(wchar_t) < n)return false;
+    s = std::wstring_view(reinterpret_cast<const wchar_t*>(p), n);
+    p += n * sizeof(wchar_t);
+    return true;
+  }
+  template<class T> static void put(std::string& buf, const T& v) {
+    buf.append(reinterpret_cast<const char*>(&v), sizeof(v));
+  }
+  static void text(std::string& buf, std::wstring_view s) {
+    put(buf, static_cast<uint32_t>(s.size()));
+    buf.append(reinterpret_cast<const char*>(s.data()), s.size() * sizeof(wchar_t));
+  }
+  static uint64_t checksum(const char* p, size_t n) {
+    ContentHash h;
+    h.update(p, n);
+    return h.digest();
+  }
+  // Every field is a multiple of sizeof(wchar_t) long, so the strings can be viewed in place.
+  void load() {
+    cachedDirs.clear();
+    cache.clear();
+    std::ifstream ifs(cacheFile, std::ios::binary | std::ios::ate);
+    if (!ifs.is_open())return;
+    cache.resize(static_cast<size_t>(ifs.tellg()));
+    ifs.seekg(0);
+    uint64_t sum;
+    if (!ifs.read(cache.data(), cache.size()) || cache.size() < sizeof(Magic) + sizeof(sum) || std::memcmp(cache.data(), Magic, sizeof(Magic)) != 0)return;
+    std::memcpy(&sum, cache.data() + cache.size() - sizeof(sum), sizeof(sum));
+    if (checksum(cache.data(), cache.size() - sizeof(sum)) != sum)return;
+    const char* p = cache.data() + sizeof(Magic);
+    const char* end = cache.data() + cache.size() - sizeof(sum);
+    uint32_t version, charSize, dirCount;
+    if (!get(p, end, version) || version != Version || !get(p, end, charSize) || charSize != sizeof(wchar_t) || !get(p, end, dirCount))return;
+    cachedDirs.reserve(dirCount);
+    for (uint32_t i = 0; i < dirCount; ++i) {
+      std::wstring_view dir;
+      CachedDir d;
+      uint32_t fileCount;
+      if (!text(p, end, dir) || !get(p, end, d.hash) || !get(p, end, fileCount))break;
+      d.files.resize(fileCount);
+      for (Cached& c : d.files)
+        if (!text(p, end, c.rel) || !get(p, end, c.mtime) || !get(p, end, c.size) || !get(p, end, c.hash)) {
+          cachedDirs.clear();
+          return;
+        }
+      cachedDirs.emplace(dir, std::move(d));
+    }
+  }
+  // Only what this run saw is kept, so deleted games drop out. Written to a temporary file first.
+  bool save(const Report& report, const std::vector<std::vector<File>>& files) const {
+    std::string buf(Magic, sizeof(Magic));
+    put(buf, Version);
+    put(buf, static_cast<uint32_t>(sizeof(wchar_t)));
+    put(buf, static_cast<uint32_t>(report.games.size()));
+    for (size_t i = 0; i < files.size(); ++i) {
+      text(buf, report.games[i].dir.wstring());
+      put(buf, report.games[i].hash);
+      put(buf, static_cast<uint32_t>(std::count_if(files[i].begin(), files[i].end(), [](const File& f) { return f.ok; })));
+      for (const File& f : files[i]) {
+        if (!f.ok)continue;
+        text(buf, f.rel);
+        put(buf, f.mtime);
+        put(buf, f.size);
+        put(buf, f.hash);
+      }
+    }
+    put(buf, checksum(buf.data(), buf.size()));
+    fs::path tmp = cacheFile;
+    tmp += ".tmp";
+    {
+      std::ofstream ofs(tmp, std::ios::binary | std::ios::trunc);
+      if (!ofs.is_open() || !ofs.write(buf.data(), buf.size()))return false;
+    }
+    std::error_code ec;
+    fs::rename(tmp, cacheFile, ec);
+    return !ec;
+  }
+public:
+  CatalogVerifier(const fs::path& cacheFile, std::shared_ptr<Logger> logger, Options options)
+    : cacheFile(cacheFile), logger(logger), opt(options) {}
+  CatalogVerifier(const CatalogVerifier&) = delete;
+  CatalogVerifier& operator=(const CatalogVerifier&) = delete;
+
+  Report run(const fs::path& root) {
+    TraceSpan span("verify");
+    auto start = std::chrono::steady_clock::now();
+    Report report;
+    report.root = root;
+    if (opt.hash)load();
+    hashedFiles = 0;
+    hashedBytes = 0;
+    ScanOptions scanOptions;
+    scanOptions.threads = opt.threads;
+    ScanResult scan = GameScanner(scanOptions).scan(root);
+    std::sort(scan.gameDirs.begin(), scan.gameDirs.end());
+    report.games.resize(scan.gameDirs.size());
+    std::vector<std::vector<File>> files(scan.gameDirs.size());
+    {
+      ThreadPool pool(opt.threads);
+      for (size_t i = 0; i < scan.gameDirs.size(); ++i) {
+        report.games[i].dir = scan.gameDirs[i];
+        pool.post([this, &pool, &game = report.games[i], &list = files[i]] { check(pool, game, list); });
+      }
+      pool.wait();
+    }
+    for (size_t i = 0; i < report.games.size(); ++i) {
+      finish(report.games[i], files[i]);
+      report.files += report.games[i].files;
+      report.bytes += report.games[i].bytes;
+    }
+    report.hashedFiles = hashedFiles;
+    report.hashedBytes = hashedBytes;
+    if (opt.hash && !save(report, files))logger->err("ʂ̃LbVۑł܂łF" + cacheFile.string());
+    report.elapsedMs = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start).count();
+
+    for (const Game& g : report.games) {
+      if (!g.problems && !g.changed)continue;
+      std::string what;
+      for (const char* name : Report::problemNames(g.problems))what += std::string(what.empty() ? "" : ", ") + name;
+      if (g.problems)logger->err("̂Q[F" + g.dir.string() + " (" + what + ")");
+      else logger->info("eǑς܂F" + g.dir.string());
+    }
+    logger->info(
+      "F" + std::to_string(report.games.size()) + "" + std::to_string(report.broken()) + "ɖ, "
+      + std::to_string(report.files) + "t@C(" + std::to_string(report.bytes >> 20) + "MB)̂"
+      + std::to_string(report.hashedFiles) + "t@C(" + std::to_string(report.hashedBytes >> 20) + "MB)ǂݍ, "
+      + std::to_string(report.elapsedMs) + "ms"
+    );
+    return report;
+  }
+};
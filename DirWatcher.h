@@ -0,0 +1,195 @@
+#pragma once
+#include <filesystem>
+#include <functional>
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include <unordered_set>
+#include <chrono>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <sys/inotify.h>
+#include <unistd.h>
+#endif
+
+namespace fs = std::filesystem;
+
+// Reports the paths below a folder that were created, changed, renamed or deleted. Events are held back
+// until the tree has been quiet for the debounce time (or for at most MaxDelay), so that copying a game
+// in is reported once rather than once per file. Paths that pass through a folder the filter rejects,
+// or that lie deeper than maxDepth, are not reported.
+// Windows watches the whole tree with one handle. inotify needs a watch per folder; they are added for
+// the tree at construction and for every folder created later.
+class DirWatcher {
+public:
+  using Filter = std::function<bool(const fs::path&)>;
+  static constexpr std::chrono::milliseconds MaxDelay{ 5000 };
+private:
+  using clock = std::chrono::steady_clock;
+  fs::path root;
+  int maxDepth;
+  Filter ignored;
+  std::chrono::milliseconds debounce;
+  std::unordered_set<std::wstring> pending;
+  clock::time_point firstEvent, lastEvent;
+  bool overflowed = false;
+#ifdef _WIN32
+  HANDLE dir = INVALID_HANDLE_VALUE;
+  HANDLE event = NULL;
+  OVERLAPPED overlapped = {};
+  std::vector<DWORD> buffer = std::vector<DWORD>(16 * 1024);
+
+  bool arm() {
+    overlapped = {};
+    overlapped.hEvent = event;
+    return ReadDirectoryChangesW(
+      dir, buffer.data(), static_cast<DWORD>(buffer.size() * sizeof(DWORD)), TRUE,
+      FILE_NOTIFY_CHANGE_FILE_NAME | FILE_NOTIFY_CHANGE_DIR_NAME | FILE_NOTIFY_CHANGE_LAST_WRITE | FILE_NOTIFY_CHANGE_SIZE,
+      NULL, &overlapped, NULL) != FALSE;
+  }
+  void read() {
+    DWORD bytes = 0;
+    if (dir == INVALID_HANDLE_VALUE || !GetOverlappedResult(dir, &overlapped, &bytes, FALSE))return;
+    // Zero bytes: more changes than the buffer holds.
+    if (bytes == 0)overflowed = true;
+    const char* p = reinterpret_cast<const char*>(buffer.data());
+    for (DWORD offset = 0; bytes > 0;) {
+      auto info = reinterpret_cast<const FILE_NOTIFY_INFORMATION*>(p + offset);
+      changed(root / std::wstring(info->FileName, info->FileNameLength / sizeof(WCHAR)));
+      if (info->NextEntryOffset == 0)break;
+      offset += info->NextEntryOffset;
+    }
+    if (!arm())overflowed = true;
+  }
+#else
+  int fd = -1;
+  std::unordered_map<int, fs::path> dirs;
+
+  void add(const fs::path& path, int depth) {
+    int wd = inotify_add_watch(fd, path.c_str(),
+      IN_CREATE | IN_DELETE | IN_MODIFY | IN_CLOSE_WRITE | IN_MOVED_FROM | IN_MOVED_TO | IN_DELETE_SELF | IN_ONLYDIR);
+    if (wd < 0)return;
+    dirs[wd] = path;
+    if (depth >= maxDepth)return;
+    std::error_code ec;
+    fs::directory_iterator itr(path, fs::directory_options::skip_permission_denied, ec), end;
+    for (; !ec && itr != end; itr.increment(ec))
+      if (itr->is_directory(ec) && !ignored(itr->path()))add(itr->path(), depth + 1);
+  }
+  void read() {
+    alignas(inotify_event) char buf[16 * 1024];
+    for (;;) {
+      ssize_t n = ::read(fd, buf, sizeof(buf));
+      if (n <= 0)return;
+      for (char* p = buf; p < buf + n;) {
+        auto e = reinterpret_cast<const inotify_event*>(p);
+        p += sizeof(inotify_event) + e->len;
+        if (e->mask & IN_Q_OVERFLOW) {
+          overflowed = true;
+          continue;
+        }
+        auto itr = dirs.find(e->wd);
+        if (itr == dirs.end())continue;
+        if (e->mask & IN_IGNORED) {
+          dirs.erase(itr);
+          continue;
+        }
+        fs::path path = e->len > 0 ? itr->second / e->name : itr->second;
+        if ((e->mask & IN_ISDIR) && (e->mask & (IN_CREATE | IN_MOVED_TO)))watch(path);
+        changed(path);
+      }
+    }
+  }
+#endif
+  // Depth below root, or -1 if the path is outside it or passes through an ignored folder.
+  int depth(const fs::path& path) const {
+    fs::path rel = path.lexically_relative(root);
+    if (rel.empty() || *rel.begin() == "..")return -1;
+    int d = 0;
+    fs::path partial = root;
+    for (const auto& part : rel) {
+      if (part == ".")continue;
+      partial /= part;
+      if (ignored(partial))return -1;
+      ++d;
+    }
+    return d;
+  }
+  void changed(const fs::path& path) {
+    int d = depth(path);
+    if (d < 0 || d > maxDepth + 1)return;
+    auto now = clock::now();
+    if (pending.empty())firstEvent = now;
+    lastEvent = now;
+    pending.insert(path.wstring());
+  }
+public:
+  // maxDepth is the deepest folder watched (root is depth 0); changes to files directly in those folders
+  // are still reported.
+  DirWatcher(const fs::path& root, int maxDepth, Filter ignored, std::chrono::milliseconds debounce)
+    : root(root), maxDepth(maxDepth), ignored(std::move(ignored)), debounce(debounce) {
+#ifdef _WIN32
+    dir = CreateFileW(root.c_str(), FILE_LIST_DIRECTORY, FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE,
+      NULL, OPEN_EXISTING, FILE_FLAG_BACKUP_SEMANTICS | FILE_FLAG_OVERLAPPED, NULL);
+    if (dir == INVALID_HANDLE_VALUE)return;
+    event = CreateEventW(NULL, TRUE, FALSE, NULL);
+    if (event == NULL || !arm()) {
+      CloseHandle(dir);
+      dir = INVALID_HANDLE_VALUE;
+    }
+#else
+    fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if (fd >= 0)add(root, 0);
+#endif
+  }
+  DirWatcher(const DirWatcher&) = delete;
+  DirWatcher& operator=(const DirWatcher&) = delete;
+  ~DirWatcher() {
+#ifdef _WIN32
+    if (dir != INVALID_HANDLE_VALUE) {
+      DWORD bytes;
+      CancelIoEx(dir, &overlapped);
+      GetOverlappedResult(dir, &overlapped, &bytes, TRUE);
+      CloseHandle(dir);
+    }
+    if (event != NULL)CloseHandle(event);
+#else
+    if (fd >= 0)close(fd);
+#endif
+  }
+
+  bool ok() const {
+#ifdef _WIN32
+    return dir != INVALID_HANDLE_VALUE;
+#else
+    return fd >= 0;
+#endif
+  }
+  // Makes sure a folder and the folders below it are watched, e.g. one that was found by scanning after
+  // it had been created. Windows watches the whole tree anyway.
+  void watch(const fs::path& path) {
+#ifndef _WIN32
+    int d = depth(path);
+    if (fd >= 0 && d >= 0 && d <= maxDepth)add(path, d);
+#endif
+  }
+
+  // Takes the new events without blocking. Once the tree has been quiet for the debounce time, moves the
+  // changed paths into changed and returns true. overflow is set if events were lost; the caller then has
+  // to treat the whole tree as changed.
+  bool poll(std::vector<fs::path>& changed, bool& overflow) {
+    read();
+    changed.clear();
+    overflow = false;
+    if (pending.empty() && !overflowed)return false;
+    auto now = clock::now();
+    if (!overflowed && now - lastEvent < debounce && now - firstEvent < MaxDelay)return false;
+    for (const auto& path : pending)changed.emplace_back(path);
+    pending.clear();
+    overflow = overflowed;
+    overflowed = false;
+    return true;
+  }
+};
@@ -0,0 +1,192 @@
+#pragma once
+#include "DxLib.h"
+#include <cstring>
+#include "Platform.h"
+
+static_assert(Input::PadDown == PAD_INPUT_DOWN && Input::PadLeft == PAD_INPUT_LEFT
+  && Input::PadRight == PAD_INPUT_RIGHT && Input::PadUp == PAD_INPUT_UP && Input::PadX == PAD_INPUT_X);
+static_assert(Input::MouseLeft == MOUSE_INPUT_LEFT && Input::KeyEscape == KEY_INPUT_ESCAPE && Input::KeyReturn == KEY_INPUT_RETURN);
+static_assert(Input::CharBack == CTRL_CODE_BS && Input::CharTab == CTRL_CODE_TAB && Input::CharEscape == CTRL_CODE_ESC);
+
+class DxPlatform : public Platform {
+  std::vector<VERTEX2D> vertices;
+
+  static std::shared_ptr<const Pixels> decodeSoftImage(int src) {
+    if (src == -1)return nullptr;
+    auto pixels = std::make_shared<Pixels>();
+    GetSoftImageSize(src, &pixels->width, &pixels->height);
+    int dst = MakeARGB8ColorSoftImage(pixels->width, pixels->height);
+    BltSoftImage(0, 0, pixels->width, pixels->height, src, 0, 0, dst);
+    pixels->argb.resize(static_cast<size_t>(pixels->width) * pixels->height);
+    const char* addr = static_cast<const char*>(GetImageAddressSoftImage(dst));
+    int pitch = GetPitchSoftImage(dst);
+    for (int y = 0; y < pixels->height; ++y)
+      memcpy(&pixels->argb[static_cast<size_t>(y) * pixels->width], addr + static_cast<size_t>(y) * pitch, pixels->width * sizeof(unsigned int));
+    DeleteSoftImage(dst);
+    DeleteSoftImage(src);
+    return pixels;
+  }
+public:
+  bool processMessages() override {
+    return ProcessMessage() != -1;
+  }
+  void readInput(InputState& state) override {
+    GetHitKeyStateAll(state.keys);
+    // Letters are typed into the search rather than mapped onto pad buttons, so of the keyboard only the
+    // arrow keys act as a pad.
+    state.joypad = GetJoypadInputState(DX_INPUT_PAD1);
+    if (state.keys[KEY_INPUT_DOWN])state.joypad |= PAD_INPUT_DOWN;
+    if (state.keys[KEY_INPUT_LEFT])state.joypad |= PAD_INPUT_LEFT;
+    if (state.keys[KEY_INPUT_RIGHT])state.joypad |= PAD_INPUT_RIGHT;
+    if (state.keys[KEY_INPUT_UP])state.joypad |= PAD_INPUT_UP;
+    GetMousePoint(&state.mouseX, &state.mouseY);
+    state.mouseButtons = GetMouseInput();
+    state.text.clear();
+    for (TCHAR c; (c = GetInputChar(TRUE)) != 0;)state.text += c;
+  }
+  long long nowUs() override {
+    return GetNowHiPerformanceCount();
+  }
+  void sleepMs(int ms) override {
+    WaitTimer(ms);
+  }
+
+  std::shared_ptr<const Pixels> decodeImage(const char* data, size_t size) override {
+    return decodeSoftImage(LoadSoftImageToMem(data, static_cast<int>(size)));
+  }
+  std::shared_ptr<const Pixels> decodeImage(const fs::path& path) override {
+    return decodeSoftImage(LoadSoftImage(path.c_str()));
+  }
+  int createTexture(const Pixels& pixels) override {
+    return createTexture(pixels.argb.data(), pixels.width, pixels.height);
+  }
+  int createTexture(const unsigned int* argb, int width, int height) override {
+    int soft = MakeARGB8ColorSoftImage(width, height);
+    char* addr = static_cast<char*>(GetImageAddressSoftImage(soft));
+    int pitch = GetPitchSoftImage(soft);
+    for (int y = 0; y < height; ++y)
+      memcpy(addr + static_cast<size_t>(y) * pitch, argb + static_cast<size_t>(y) * width, width * sizeof(unsigned int));
+    int handle = CreateGraphFromSoftImage(soft);
+    DeleteSoftImage(soft);
+    return handle;
+  }
+  int openMovie(const fs::path& path) override {
+    SetUseASyncLoadFlag(TRUE);
+    int handle = LoadGraph(path.c_str());
+    SetUseASyncLoadFlag(FALSE);
+    return handle;
+  }
+  int loadStatus(int handle) override {
+    int status = CheckHandleASyncLoad(handle);
+    return status == TRUE ? 1 : status == FALSE ? 0 : -1;
+  }
+  void playMovie(int handle, bool rewind) override {
+    if (rewind)SeekMovieToGraph(handle, 0);
+    PlayMovieToGraph(handle, DX_PLAYTYPE_LOOP);
+  }
+  void pauseMovie(int handle) override {
+    PauseMovieToGraph(handle);
+  }
+  int makeScreen(int width, int height) override {
+    return MakeScreen(width, height, FALSE);
+  }
+  void deleteGraph(int handle) override {
+    DeleteGraph(handle);
+  }
+  void graphSize(int handle, int& width, int& height) override {
+    GetGraphSize(handle, &width, &height);
+  }
+  std::shared_ptr<const Pixels> capture(int handle) override {
+    int width, height;
+    if (GetGraphSize(handle, &width, &height) == -1)return nullptr;
+    int screen = MakeScreen(width, height, FALSE);
+    int prevScreen = GetDrawScreen();
+    SetDrawScreen(screen);
+    DrawGraph(0, 0, handle, FALSE);
+    int soft = MakeARGB8ColorSoftImage(width, height);
+    GetDrawScreenSoftImage(0, 0, width, height, soft);
+    SetDrawScreen(prevScreen);
+    DeleteGraph(screen);
+    return decodeSoftImage(soft);
+  }
+
+  void setDrawScreen(int handle) override {
+    SetDrawScreen(handle == -1 ? DX_SCREEN_BACK : handle);
+  }
+  void clear() override {
+    ClearDrawScreen();
+  }
+  void setBlend(int alpha) override {
+    if (alpha >= 255)SetDrawBlendMode(DX_BLENDMODE_NOBLEND, 0);
+    else SetDrawBlendMode(DX_BLENDMODE_ALPHA, alpha);
+  }
+  void roundRect(float x1, float y1, float x2, float y2, float rx, float ry, unsigned int color, bool fill) override {
+    DrawRoundRectAA(x1, y1, x2, y2, rx, ry, 32, color, fill);
+    ++drawCalls;
+  }
+  void triangle(float x1, float y1, float x2, float y2, float x3, float y3, unsigned int color, bool fill) override {
+    DrawTriangleAA(x1, y1, x2, y2, x3, y3, color, fill);
+    ++drawCalls;
+  }
+  void drawGraph(float x1, float y1, float x2, float y2, int handle, bool trans) override {
+    DrawExtendGraphF(x1, y1, x2, y2, handle, trans);
+    ++drawCalls;
+  }
+  void drawQuads(const Quad* quads, size_t count, int handle) override {
+    if (count == 0)return;
+    vertices.resize(count * 6);
+    COLOR_U8 white = GetColorU8(255, 255, 255, 255);
+    for (size_t i = 0; i < count; ++i) {
+      const Quad& q = quads[i];
+      VERTEX2D* v = &vertices[i * 6];
+      const float corners[6][4] = {
+        { q.x1, q.y1, q.u1, q.v1 }, { q.x2, q.y1, q.u2, q.v1 }, { q.x1, q.y2, q.u1, q.v2 },
+        { q.x2, q.y1, q.u2, q.v1 }, { q.x2, q.y2, q.u2, q.v2 }, { q.x1, q.y2, q.u1, q.v2 }
+      };
+      for (int c = 0; c < 6; ++c) {
+        v[c].pos = VGet(corners[c][0], corners[c][1], 0.f);
+        v[c].rhw = 1.f;
+        v[c].dif = white;
+        v[c].u = corners[c][2];
+        v[c].v = corners[c][3];
+      }
+    }
+    int mode, param;
+    GetDrawBlendMode(&mode, &param);
+    SetDrawBlendMode(DX_BLENDMODE_PMA_ALPHA, 255);
+    DrawPrimitive2D(vertices.data(), static_cast<int>(vertices.size()), DX_PRIMTYPE_TRIANGLELIST, handle, TRUE);
+    SetDrawBlendMode(mode, param);
+    ++drawCalls;
+  }
+  void text(float x, float y, unsigned int color, const wchar_t* str) override {
+    DrawStringF(x, y, str, color);
+    ++drawCalls;
+  }
+  int textWidth(const wchar_t* str) override {
+    return GetDrawStringWidth(str, GetStringLength(str));
+  }
+  int fontSize() override {
+    return GetFontSize();
+  }
+  int renderText(const wchar_t* str, unsigned int color, int& width, int& height) override {
+    static constexpr int MaxTextureSize = 4096;
+    int lines;
+    if (GetDrawStringSize(&width, &height, &lines, str, GetStringLength(str)) == -1)width = height = 0;
+    if (width <= 0 || height <= 0 || width > MaxTextureSize || height > MaxTextureSize)return -1;
+    int handle = MakeScreen(width, height, TRUE);
+    if (handle == -1)return -1;
+    int prevScreen = GetDrawScreen();
+    int mode, param;
+    GetDrawBlendMode(&mode, &param);
+    SetDrawScreen(handle);
+    FillGraph(handle, 0, 0, 0, 0);
+    SetDrawBlendMode(DX_BLENDMODE_NOBLEND, 0);
+    DrawString(0, 0, str, color);
+    SetDrawBlendMode(mode, param);
+    SetDrawScreen(prevScreen);
+    return handle;
+  }
+  void present() override {
+    ScreenFlip();
+  }
+};
@@ -0,0 +1,524 @@
+#pragma once
+#include <filesystem>
+#include <fstream>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+#include <map>
+#include <mutex>
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+#include "SettingsParser.h"
+#include "Catalog.h"
+
+namespace fs = std::filesystem;
+
+// A game packed into a single .lpk file in Games/, in place of its folder. The catalog reads settings.json
+// with one read of the head of the pack, and the menu maps the pack read-only and decodes the icon and the
+// detail image where they lie in the mapping, so no file of a packed game is opened on its own. The pack
+// stands for the game folder, and a file in it has the path it would have in the folder
+// ("Games/foo.lpk/image/icon.png"). The rest of the game is only written out, to a local cache, when the
+// game is launched.
+//
+// Layout: Header, settings.json, the directory (one Entry per file, sorted by name), the names (UTF-8,
+// '/' separated, relative to the game folder), then the other files stored as they are: the icon and the
+// detail image first, so that the menu only touches the first pages of a pack, then the rest on 4KB
+// boundaries. A pack made with PackWriter::write(..., false) holds only those three files and records the
+// folder it was made from, which the game then runs from.
+class GamePack {
+  static constexpr char Magic[4] = { 'L', 'P', 'A', 'K' };
+  static constexpr uint32_t Version = 1;
+  static constexpr uint32_t HasPayload = 1;
+  static constexpr size_t HeadBytes = 8 << 10;
+  struct Header {
+    char magic[4];
+    uint32_t version;
+    uint32_t entries;
+    uint32_t flags;
+    uint64_t directory;
+    uint64_t names;
+    uint64_t namesBytes;
+    // The folder the pack was made from, in the names.
+    uint32_t source;
+    uint32_t sourceLength;
+    uint64_t bytes;
+    // settings.json, which is also in the directory.
+    uint32_t settings;
+    uint32_t settingsSize;
+  };
+  struct Entry {
+    uint64_t offset;
+    uint64_t size;
+    int64_t mtime;
+    uint32_t name;
+    uint32_t nameLength;
+  };
+  static_assert(sizeof(Header) == 64 && sizeof(Entry) == 32, "file layout");
+  friend class PackWriter;
+
+  fs::path file;
+#ifdef _WIN32
+  HANDLE mapping = NULL;
+#endif
+  const char* view = nullptr;
+  size_t length = 0;
+  int64_t fileTime = 0;
+  const Header* header = nullptr;
+  const Entry* directory = nullptr;
+
+  static char lower(char c) {
+    return 'A' <= c && c <= 'Z' ? c - 'A' + 'a' : c;
+  }
+  // Names are compared ignoring ASCII case, as the file system of the folders they came from does.
+  static int compare(std::string_view a, std::string_view b) {
+    for (size_t i = 0; i < a.size() && i < b.size(); ++i) {
+      char x = lower(a[i]), y = lower(b[i]);
+      if (x != y)return static_cast<unsigned char>(x) < static_cast<unsigned char>(y) ? -1 : 1;
+    }
+    return a.size() < b.size() ? -1 : a.size() > b.size() ? 1 : 0;
+  }
+  std::string_view text(uint32_t offset, uint32_t size) const {
+    return std::string_view(view + header->names + offset, size);
+  }
+  std::string stamp() const {
+    return std::to_string(length) + " " + std::to_string(fileTime) + "\n";
+  }
+  // A name is joined onto the extraction folder, so it must stay below it: relative, without a drive
+  // and without "." or ".." components.
+  static bool safeName(std::string_view n) {
+    if (n.empty() || n.find(':') != std::string_view::npos || n.find('\0') != std::string_view::npos)return false;
+    for (size_t begin = 0; begin <= n.size();) {
+      size_t end = std::min(n.find_first_of("/\\", begin), n.size());
+      std::string_view part = n.substr(begin, end - begin);
+      if (part.empty() || part == "." || part == "..")return false;
+      begin = end + 1;
+    }
+    return true;
+  }
+  static bool known(const Header* h) {
+    return std::memcmp(h->magic, Magic, sizeof(Magic)) == 0 && h->version == Version;
+  }
+  bool valid() const {
+    if (!known(header) || header->bytes != length)return false;
+    if (header->directory % alignof(Entry) != 0 || header->directory > length
+      || header->entries > (length - header->directory) / sizeof(Entry))return false;
+    if (header->names < header->directory + sizeof(Entry) * header->entries || header->names > length
+      || header->namesBytes > length - header->names)return false;
+    if (static_cast<uint64_t>(header->source) + header->sourceLength > header->namesBytes)return false;
+    for (uint32_t i = 0; i < header->entries; ++i) {
+      const Entry& e = directory[i];
+      if (static_cast<uint64_t>(e.name) + e.nameLength > header->namesBytes || !safeName(text(e.name, e.nameLength)))return false;
+      if (e.offset > length || e.size > length - e.offset)return false;
+    }
+    return true;
+  }
+public:
+  static constexpr const wchar_t* Extension = L".lpk";
+
+  GamePack() = default;
+  GamePack(const GamePack&) = delete;
+  GamePack& operator=(const GamePack&) = delete;
+  ~GamePack() {
+    close();
+  }
+
+  static bool isPack(const fs::path& path) {
+    std::wstring ext = path.extension().wstring();
+    if (ext.size() != 4)return false;
+    for (size_t i = 0; i < ext.size(); ++i)
+      if ((L'A' <= ext[i] && ext[i] <= L'Z' ? ext[i] - L'A' + L'a' : ext[i]) != Extension[i])return false;
+    return true;
+  }
+  // Splits a path into a game file into the pack and the file's name in it. False if no folder on the
+  // path is a pack.
+  static bool split(const fs::path& path, fs::path& pack, std::string& name) {
+    pack.clear();
+    name.clear();
+    bool inside = false;
+    for (const auto& part : path) {
+      if (inside) {
+        if (!name.empty())name += '/';
+        name += part.u8string();
+      }
+      else {
+        pack /= part;
+        inside = isPack(part);
+      }
+    }
+    return inside && !name.empty();
+  }
+
+  bool open(const fs::path& path) {
+    close();
+    std::error_code ec;
+    auto time = fs::last_write_time(path, ec);
+    if (ec)return false;
+    fileTime = time.time_since_epoch().count();
+#ifdef _WIN32
+    HANDLE h = CreateFileW(path.c_str(), GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_DELETE, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+    if (h == INVALID_HANDLE_VALUE)return false;
+    LARGE_INTEGER bytes;
+    if (GetFileSizeEx(h, &bytes) && bytes.QuadPart >= static_cast<LONGLONG>(sizeof(Header))) {
+      mapping = CreateFileMappingW(h, NULL, PAGE_READONLY, 0, 0, NULL);
+      if (mapping != NULL)view = static_cast<const char*>(MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0));
+      length = static_cast<size_t>(bytes.QuadPart);
+    }
+    CloseHandle(h);
+#else
+    int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0)return false;
+    struct stat st;
+    if (fstat(fd, &st) == 0 && st.st_size >= static_cast<off_t>(sizeof(Header))) {
+      void* p = mmap(nullptr, static_cast<size_t>(st.st_size), PROT_READ, MAP_SHARED, fd, 0);
+      if (p != MAP_FAILED) {
+        view = static_cast<const char*>(p);
+        length = static_cast<size_t>(st.st_size);
+      }
+    }
+    ::close(fd);
+#endif
+    if (!view) {
+      close();
+      return false;
+    }
+    header = reinterpret_cast<const Header*>(view);
+    directory = reinterpret_cast<const Entry*>(view + header->directory);
+    if (!valid()) {
+      close();
+      return false;
+    }
+    file = path;
+    return true;
+  }
+  void close() {
+#ifdef _WIN32
+    if (view)UnmapViewOfFile(view);
+    if (mapping != NULL)CloseHandle(mapping);
+    mapping = NULL;
+#else
+    if (view)munmap(const_cast<char*>(view), length);
+#endif
+    view = nullptr;
+    length = 0;
+    header = nullptr;
+    directory = nullptr;
+    file.clear();
+  }
+  bool isOpen() const {
+    return view != nullptr;
+  }
+  const fs::path& path() const {
+    return file;
+  }
+  size_t size() const {
+    return header ? header->entries : 0;
+  }
+  std::string_view name(size_t i) const {
+    return text(directory[i].name, directory[i].nameLength);
+  }
+  std::string_view data(size_t i) const {
+    return std::string_view(view + directory[i].offset, static_cast<size_t>(directory[i].size));
+  }
+  bool payload() const {
+    return header && (header->flags & HasPayload);
+  }
+  // The folder the pack was made from; a pack without payload runs the game from there.
+  fs::path source() const {
+    return header ? fs::u8path(text(header->source, header->sourceLength)) : fs::path();
+  }
+  // Binary search on the directory; data points into the mapping and stays valid until the pack is closed.
+  bool find(std::string_view name, std::string_view& data) const {
+    size_t lo = 0, hi = size();
+    while (lo < hi) {
+      size_t mid = (lo + hi) / 2;
+      int c = compare(this->name(mid), name);
+      if (c == 0) {
+        data = this->data(mid);
+        return true;
+      }
+      if (c < 0)lo = mid + 1;
+      else hi = mid;
+    }
+    return false;
+  }
+  // Where a file lies in the pack file, for reading it without the mapping.
+  bool locate(std::string_view name, uint64_t& offset, uint64_t& size) const {
+    std::string_view data;
+    if (!find(name, data))return false;
+    offset = static_cast<uint64_t>(data.data() - view);
+    size = data.size();
+    return true;
+  }
+  // Of the whole pack file.
+  uint64_t bytes() const {
+    return length;
+  }
+  // Reads settings.json of the pack at path with a single read of its head, without mapping the pack:
+  // mapping costs more than reading a small file. A settings.json too large for the head is read from the
+  // mapping.
+  static bool readSettings(const fs::path& path, std::string& out) {
+    thread_local std::vector<char> head(HeadBytes);
+    std::ifstream ifs(path, std::ios::binary);
+    if (!ifs.is_open())return false;
+    ifs.read(head.data(), head.size());
+    size_t available = static_cast<size_t>(ifs.gcount());
+    const Header* h = reinterpret_cast<const Header*>(head.data());
+    if (available < sizeof(Header) || !known(h))return false;
+    if (static_cast<uint64_t>(h->settings) + h->settingsSize <= available) {
+      out.assign(head.data() + h->settings, h->settingsSize);
+      return true;
+    }
+    GamePack pack;
+    std::string_view data;
+    if (!pack.open(path) || !pack.find("settings.json", data))return false;
+    out.assign(data);
+    return true;
+  }
+
+  // Whether dest holds this version of the pack, written out by extract().
+  bool extracted(const fs::path& dest) const {
+    if (!isOpen())return false;
+    std::ifstream ifs(dest / ".lpk", std::ios::binary);
+    std::string current((std::istreambuf_iterator<char>(ifs)), std::istreambuf_iterator<char>());
+    return current == stamp();
+  }
+  // Writes every file of the pack into dest, unless dest already holds this version of the pack. The files
+  // are written to dest + ".tmp" first so that an interrupted extraction is never taken for a finished one.
+  bool extract(const fs::path& dest, uint64_t* written = nullptr) const {
+    if (written)*written = 0;
+    if (!isOpen())return false;
+    if (extracted(dest))return true;
+    std::error_code ec;
+    fs::path tmp = dest;
+    tmp += ".tmp";
+    fs::remove_all(tmp, ec);
+    for (size_t i = 0; i < size(); ++i) {
+      fs::path out = tmp / fs::u8path(name(i));
+      fs::create_directories(out.parent_path(), ec);
+      std::ofstream ofs(out, std::ios::binary);
+      std::string_view contents = data(i);
+      if (!ofs.is_open() || !ofs.write(contents.data(), contents.size()))return false;
+      ofs.close();
+      fs::last_write_time(out, fs::file_time_type(fs::file_time_type::duration(directory[i].mtime)), ec);
+      if (written)*written += contents.size();
+    }
+    {
+      std::ofstream ofs(tmp / ".lpk", std::ios::binary);
+      if (!(ofs << stamp()))return false;
+    }
+    fs::remove_all(dest, ec);
+    fs::create_directories(dest.parent_path(), ec);
+    fs::rename(tmp, dest, ec);
+    return !ec;
+  }
+};
+
+// Makes a pack out of a game folder.
+class PackWriter {
+  struct File {
+    fs::path path;
+    std::string name;
+    uint64_t size;
+    int64_t mtime;
+    bool meta;
+  };
+  static uint64_t align(uint64_t offset, uint64_t to) {
+    return (offset + to - 1) / to * to;
+  }
+public:
+  // payload = false packs only settings.json, the icon and the detail image. The pack is written to a
+  // temporary file and renamed to out once complete.
+  static bool write(const fs::path& dir, const fs::path& out, bool payload, std::string& error) {
+    std::vector<std::string> metaNames = { "settings.json" };
+    {
+      CatalogEntry entry;
+      SettingsError settingsError;
+      if (SettingsParser::parseFile(dir / "settings.json", dir, entry, settingsError)) {
+        for (const fs::path& p : { entry.icon, entry.detail }) {
+          fs::path rel = p.lexically_relative(dir);
+          if (!rel.empty() && *rel.begin() != "..")metaNames.push_back(rel.generic_u8string());
+        }
+      }
+    }
+    auto isMeta = [&metaNames](std::string_view name) {
+      for (const auto& m : metaNames)
+        if (GamePack::compare(m, name) == 0)return true;
+      return false;
+    };
+
+    std::vector<File> files;
+    std::error_code ec;
+    auto add = [&](const fs::path& path) {
+      auto size = fs::file_size(path, ec);
+      if (ec)return;
+      auto time = fs::last_write_time(path, ec);
+      if (ec)return;
+      std::string name = path.lexically_relative(dir).generic_u8string();
+      files.push_back({ path, name, size, static_cast<int64_t>(time.time_since_epoch().count()), isMeta(name) });
+    };
+    if (payload) {
+      fs::recursive_directory_iterator itr(dir, fs::directory_options::skip_permission_denied, ec), end;
+      for (; !ec && itr != end; itr.increment(ec))
+        if (itr->is_regular_file(ec))add(itr->path());
+      if (ec) {
+        error = "cannot list " + dir.u8string();
+        return false;
+      }
+    }
+    else
+      for (const auto& m : metaNames)
+        if (fs::is_regular_file(dir / fs::u8path(m), ec))add(dir / fs::u8path(m));
+    std::sort(files.begin(), files.end(), [](const File& a, const File& b) { return GamePack::compare(a.name, b.name) < 0; });
+    for (size_t i = 1; i < files.size(); ++i)
+      if (GamePack::compare(files[i - 1].name, files[i].name) == 0) {
+        error = "names differing only in case: " + files[i].name;
+        return false;
+      }
+    size_t settings = std::find_if(files.begin(), files.end(), [](const File& f) { return f.name == "settings.json"; }) - files.begin();
+    if (settings == files.size()) {
+      error = "no settings.json in " + dir.u8string();
+      return false;
+    }
+
+    GamePack::Header header{};
+    std::memcpy(header.magic, GamePack::Magic, sizeof(header.magic));
+    header.version = GamePack::Version;
+    header.entries = static_cast<uint32_t>(files.size());
+    header.flags = payload ? GamePack::HasPayload : 0;
+    std::string names;
+    std::vector<GamePack::Entry> directory(files.size());
+    for (size_t i = 0; i < files.size(); ++i) {
+      directory[i].name = static_cast<uint32_t>(names.size());
+      directory[i].nameLength = static_cast<uint32_t>(files[i].name.size());
+      directory[i].size = files[i].size;
+      directory[i].mtime = files[i].mtime;
+      names += files[i].name;
+    }
+    std::string source = fs::absolute(dir).u8string();
+    header.source = static_cast<uint32_t>(names.size());
+    header.sourceLength = static_cast<uint32_t>(source.size());
+    names += source;
+    // settings.json right after the header, where GamePack::readSettings() finds it with the first read,
+    // then the directory and the names, the images and last the payload on page boundaries.
+    header.settings = sizeof(header);
+    header.settingsSize = static_cast<uint32_t>(files[settings].size);
+    directory[settings].offset = header.settings;
+    header.directory = align(header.settings + header.settingsSize, alignof(GamePack::Entry));
+    header.names = header.directory + sizeof(GamePack::Entry) * directory.size();
+    header.namesBytes = names.size();
+    uint64_t offset = header.names + header.namesBytes;
+    std::vector<size_t> order;
+    for (bool meta : { true, false })
+      for (size_t i = 0; i < files.size(); ++i)
+        if (i != settings && files[i].meta == meta) {
+          offset = align(offset, meta ? 8 : 4096);
+          directory[i].offset = offset;
+          offset += files[i].size;
+          order.push_back(i);
+        }
+    header.bytes = offset;
+
+    fs::path tmp = out;
+    tmp += ".tmp";
+    fs::create_directories(out.parent_path(), ec);
+    {
+      std::ofstream ofs(tmp, std::ios::binary);
+      if (!ofs.is_open()) {
+        error = "cannot create " + tmp.u8string();
+        return false;
+      }
+      uint64_t at = 0;
+      // Pads up to pos and writes there.
+      auto put = [&](const void* data, uint64_t pos, size_t size) {
+        static const char zeros[4096] = {};
+        ofs.write(zeros, static_cast<std::streamsize>(pos - at));
+        ofs.write(static_cast<const char*>(data), size);
+        at = pos + size;
+      };
+      std::vector<char> buf(1 << 20);
+      auto copy = [&](size_t i) {
+        std::ifstream ifs(files[i].path, std::ios::binary);
+        uint64_t left = files[i].size, pos = directory[i].offset;
+        while (ifs && left > 0) {
+          size_t n = static_cast<size_t>(std::min<uint64_t>(left, buf.size()));
+          if (!ifs.read(buf.data(), n))break;
+          put(buf.data(), pos, n);
+          pos += n;
+          left -= n;
+        }
+        if (left == 0)return true;
+        ofs.close();
+        fs::remove(tmp, ec);
+        error = "cannot read " + files[i].path.u8string();
+        return false;
+      };
+      put(&header, 0, sizeof(header));
+      if (!copy(settings))return false;
+      put(directory.data(), header.directory, sizeof(GamePack::Entry) * directory.size());
+      put(names.data(), header.names, names.size());
+      for (size_t i : order)
+        if (!copy(i))return false;
+      if (!ofs.flush()) {
+        ofs.close();
+        fs::remove(tmp, ec);
+        error = "cannot write " + tmp.u8string();
+        return false;
+      }
+    }
+    fs::rename(tmp, out, ec);
+    if (ec) {
+      fs::remove(tmp, ec);
+      error = "cannot rename to " + out.u8string();
+      return false;
+    }
+    return true;
+  }
+};
+
+// The packs the launcher has opened, shared by the threads reading assets. A pack stays mapped while the
+// set or a reader holds on to it, so a pack can be forgotten (once it changed on disk) while a read from it
+// is still on its way to the main thread.
+class GamePacks {
+  mutable std::mutex mtx;
+  std::map<fs::path, std::shared_ptr<GamePack>> packs;
+public:
+  // Opens the pack on first use; null if it cannot be opened (and is not tried again until forgotten).
+  std::shared_ptr<const GamePack> open(const fs::path& file) {
+    std::lock_guard<std::mutex> lock(mtx);
+    auto& pack = packs[file];
+    if (!pack) {
+      pack = std::make_shared<GamePack>();
+      pack->open(file);
+    }
+    return pack->isOpen() ? pack : nullptr;
+  }
+  // Finds a file given by its path in a game folder that is a pack. pack keeps data mapped.
+  bool read(const fs::path& path, std::string_view& data, std::shared_ptr<const GamePack>& pack) {
+    fs::path file;
+    std::string name;
+    if (!GamePack::split(path, file, name))return false;
+    pack = open(file);
+    return pack && pack->find(name, data);
+  }
+  // The pack is opened again on the next read, e.g. after CatalogReloader saw it change.
+  void forget(const fs::path& file) {
+    std::lock_guard<std::mutex> lock(mtx);
+    packs.erase(file);
+  }
+  size_t size() const {
+    std::lock_guard<std::mutex> lock(mtx);
+    return packs.size();
+  }
+};
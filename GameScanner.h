@@ -0,0 +1,140 @@
+#pragma once
+#include <filesystem>
+#include <string>
+#include <vector>
+#include <mutex>
+#include <atomic>
+#include <chrono>
+#include <algorithm>
+#include <functional>
+#include <cstdint>
+
+#include "ThreadPool.h"
+
+namespace fs = std::filesystem;
+
+struct ScanOptions {
+  fs::path metaFile = "settings.json";
+  // Files that are a whole game packed into one (GamePack.h).
+  std::wstring pack = L"*.lpk";
+  // Depth of the deepest folder that may still hold a settings.json (Games/ itself is depth 0).
+  int maxDepth = 4;
+  // Folder names that are never entered. '*' matches any run of characters, compared case-insensitively.
+  std::vector<std::wstring> ignore = {
+    L".*",
+    L"*_Data",
+    L"MonoBleedingEdge",
+    L"__MACOSX",
+  };
+  size_t threads = 0;
+};
+
+struct DirStamp {
+  fs::path path;
+  int64_t mtime;
+};
+
+struct ScanResult {
+  std::vector<fs::path> gameDirs;
+  // Folders whose entries were listed. Their mtimes change whenever a game folder is added or removed below them.
+  std::vector<DirStamp> walkedDirs;
+  std::vector<fs::path> errorDirs;
+  size_t visitedDirs = 0;
+  size_t ignoredDirs = 0;
+  std::chrono::microseconds elapsed{};
+};
+
+class GameScanner {
+private:
+  ScanOptions opt;
+
+  static wchar_t lower(wchar_t c) {
+    return L'A' <= c && c <= L'Z' ? c - L'A' + L'a' : c;
+  }
+  static bool match(std::wstring_view pat, std::wstring_view str) {
+    size_t p = 0, s = 0, star = std::wstring_view::npos, mark = 0;
+    while (s < str.size()) {
+      if (p < pat.size() && pat[p] == L'*') {
+        star = p++;
+        mark = s;
+      }
+      else if (p < pat.size() && lower(pat[p]) == lower(str[s])) {
+        ++p;
+        ++s;
+      }
+      else if (star != std::wstring_view::npos) {
+        p = star + 1;
+        s = ++mark;
+      }
+      else return false;
+    }
+    while (p < pat.size() && pat[p] == L'*')++p;
+    return p == pat.size();
+  }
+public:
+  explicit GameScanner(ScanOptions options = {}) : opt(std::move(options)) {}
+
+  bool ignored(const fs::path& dir) const {
+    std::wstring name = dir.filename().wstring();
+    for (const auto& pat : opt.ignore)
+      if (match(pat, name))return true;
+    return false;
+  }
+
+  // Breadth-first walk on a worker pool. A folder holding settings.json is a game and is not descended into;
+  // so is a pack (GamePack.h), which is found without being opened.
+  ScanResult scan(const fs::path& root) const {
+    auto start = std::chrono::steady_clock::now();
+    ScanResult result;
+    std::mutex mtx;
+    std::atomic<size_t> visited = 0, skipped = 0;
+    {
+      ThreadPool pool(opt.threads);
+      std::function<void(fs::path, int)> visit = [&](fs::path dir, int depth) {
+        ++visited;
+        std::error_code ec;
+        if (depth > 0 && fs::is_regular_file(dir / opt.metaFile, ec)) {
+          std::lock_guard<std::mutex> lock(mtx);
+          result.gameDirs.push_back(std::move(dir));
+          return;
+        }
+        // Stamped even at the depth limit, where a settings.json added later would make this folder a game.
+        {
+          auto mtime = fs::last_write_time(dir, ec).time_since_epoch().count();
+          std::lock_guard<std::mutex> lock(mtx);
+          result.walkedDirs.push_back({ dir, ec ? -1 : static_cast<int64_t>(mtime) });
+        }
+        if (depth >= opt.maxDepth)return;
+        fs::directory_iterator itr(dir, fs::directory_options::skip_permission_denied, ec), end;
+        for (; !ec && itr != end; itr.increment(ec)) {
+          if (!itr->is_directory(ec)) {
+            if (!ec && match(opt.pack, itr->path().filename().wstring()) && itr->is_regular_file(ec)) {
+              std::lock_guard<std::mutex> lock(mtx);
+              result.gameDirs.push_back(itr->path());
+            }
+            continue;
+          }
+          if (ignored(itr->path())) {
+            ++skipped;
+            continue;
+          }
+          pool.post([&visit, p = itr->path(), depth] { visit(p, depth + 1); });
+        }
+        if (ec) {
+          std::lock_guard<std::mutex> lock(mtx);
+          result.errorDirs.push_back(dir);
+        }
+      };
+      pool.post([&] { visit(root, 0); });
+      pool.wait();
+    }
+    std::sort(result.gameDirs.begin(), result.gameDirs.end());
+    std::sort(result.walkedDirs.begin(), result.walkedDirs.end(), [](const DirStamp& a, const DirStamp& b) {
+      return a.path < b.path;
+    });
+    result.visitedDirs = visited;
+    result.ignoredDirs = skipped;
+    result.elapsed = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start);
+    return result;
+  }
+};
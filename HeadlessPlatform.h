@@ -0,0 +1,209 @@
+#pragma once
+#include <chrono>
+#include <functional>
+#include <unordered_map>
+#include <cwchar>
+#include <algorithm>
+#include "Platform.h"
+
+// Runs the menu without a window: draw commands of the current frame are recorded instead of drawn,
+// graphics are only counted, and input comes from a callback (a recorded trace in Replay). The clock is
+// the real one plus the time vsync and sleeps would have taken, so time-based behaviour (auto-repeat,
+// idle mode) plays out as on a 60 Hz kiosk while the run itself goes as fast as the frames allow.
+class HeadlessPlatform : public Platform {
+public:
+  struct Command {
+    enum Kind {
+      Clear,
+      RoundRect,
+      Triangle,
+      Graph,
+      Quads,
+      Text
+    } kind;
+    int screen;
+    int handle;
+    float x1, y1, x2, y2;
+    unsigned int color;
+  };
+  struct Counters {
+    size_t frames = 0;
+    size_t texturesCreated = 0;
+    size_t screensCreated = 0;
+    size_t graphsDeleted = 0;
+    size_t imagesDecoded = 0;
+    size_t moviesOpened = 0;
+    size_t textsRendered = 0;
+  };
+  struct Graph {
+    int width, height;
+  };
+  // Fills the input for the next frame; returning false ends the run (processMessages() turns false).
+  std::function<bool(InputState&)> input;
+  // Commands issued since the last present().
+  std::vector<Command> commands;
+  Counters counters;
+  long long frameIntervalUs = 16667;
+private:
+  std::unordered_map<int, Graph> graphs;
+  int nextHandle = 1;
+  int screen = -1;
+  bool quit = false;
+  long long skewUs = 0;
+  long long lastPresentUs = 0;
+
+  int newGraph(int width, int height) {
+    graphs[nextHandle] = { width, height };
+    return nextHandle++;
+  }
+  void record(Command::Kind kind, int handle, float x1, float y1, float x2, float y2, unsigned int color) {
+    commands.push_back({ kind, screen, handle, x1, y1, x2, y2, color });
+    ++drawCalls;
+  }
+  static std::shared_ptr<const Pixels> dummyPixels() {
+    auto pixels = std::make_shared<Pixels>();
+    pixels->width = pixels->height = 64;
+    pixels->argb.assign(64 * 64, 0xffffffff);
+    return pixels;
+  }
+public:
+  HeadlessPlatform() {
+    commands.reserve(256);
+  }
+  size_t liveGraphs() const {
+    return graphs.size();
+  }
+
+  bool processMessages() override {
+    return !quit;
+  }
+  void readInput(InputState& state) override {
+    state = InputState();
+    if (input && !input(state))quit = true;
+  }
+  long long nowUs() override {
+    return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now().time_since_epoch()).count() + skewUs;
+  }
+  void sleepMs(int ms) override {
+    skewUs += ms * 1000LL;
+  }
+
+  // Images are not decoded; anything that was read successfully becomes a blank 64x64 image.
+  std::shared_ptr<const Pixels> decodeImage(const char* data, size_t size) override {
+    if (size == 0)return nullptr;
+    ++counters.imagesDecoded;
+    return dummyPixels();
+  }
+  std::shared_ptr<const Pixels> decodeImage(const fs::path& path) override {
+    std::error_code ec;
+    if (!fs::is_regular_file(path, ec))return nullptr;
+    ++counters.imagesDecoded;
+    return dummyPixels();
+  }
+  int createTexture(const Pixels& pixels) override {
+    return createTexture(pixels.argb.data(), pixels.width, pixels.height);
+  }
+  int createTexture(const unsigned int* argb, int width, int height) override {
+    ++counters.texturesCreated;
+    return newGraph(width, height);
+  }
+  int openMovie(const fs::path& path) override {
+    ++counters.moviesOpened;
+    return newGraph(640, 360);
+  }
+  int loadStatus(int handle) override {
+    return graphs.count(handle) ? 0 : -1;
+  }
+  void playMovie(int handle, bool rewind) override {}
+  void pauseMovie(int handle) override {}
+  int makeScreen(int width, int height) override {
+    ++counters.screensCreated;
+    return newGraph(width, height);
+  }
+  void deleteGraph(int handle) override {
+    if (graphs.erase(handle))++counters.graphsDeleted;
+  }
+  void graphSize(int handle, int& width, int& height) override {
+    auto itr = graphs.find(handle);
+    if (itr == graphs.end()) {
+      width = height = 0;
+      return;
+    }
+    width = itr->second.width;
+    height = itr->second.height;
+  }
+
+  std::shared_ptr<const Pixels> capture(int handle) override {
+    auto itr = graphs.find(handle);
+    if (itr == graphs.end())return nullptr;
+    auto pixels = std::make_shared<Pixels>();
+    pixels->width = itr->second.width;
+    pixels->height = itr->second.height;
+    pixels->argb.assign(static_cast<size_t>(pixels->width) * pixels->height, 0xff000000);
+    return pixels;
+  }
+
+  void setDrawScreen(int handle) override {
+    screen = handle;
+  }
+  void clear() override {
+    commands.push_back({ Command::Clear, screen, -1, 0, 0, 0, 0, 0 });
+  }
+  void setBlend(int alpha) override {}
+  void roundRect(float x1, float y1, float x2, float y2, float rx, float ry, unsigned int color, bool fill) override {
+    record(Command::RoundRect, -1, x1, y1, x2, y2, color);
+  }
+  void triangle(float x1, float y1, float x2, float y2, float x3, float y3, unsigned int color, bool fill) override {
+    record(Command::Triangle, -1, x1, y1, x3, y3, color);
+  }
+  void drawGraph(float x1, float y1, float x2, float y2, int handle, bool trans) override {
+    record(Command::Graph, handle, x1, y1, x2, y2, 0);
+  }
+  // Recorded as one command covering all the quads.
+  void drawQuads(const Quad* quads, size_t count, int handle) override {
+    if (count == 0)return;
+    float x1 = quads[0].x1, y1 = quads[0].y1, x2 = quads[0].x2, y2 = quads[0].y2;
+    for (size_t i = 1; i < count; ++i) {
+      x1 = std::min(x1, quads[i].x1);
+      y1 = std::min(y1, quads[i].y1);
+      x2 = std::max(x2, quads[i].x2);
+      y2 = std::max(y2, quads[i].y2);
+    }
+    record(Command::Quads, handle, x1, y1, x2, y2, static_cast<unsigned int>(count));
+  }
+  void text(float x, float y, unsigned int color, const wchar_t* str) override {
+    record(Command::Text, -1, x, y, x + textWidth(str), y, color);
+  }
+  // A fixed advance per character keeps layouts reproducible between runs.
+  int textWidth(const wchar_t* str) override {
+    return static_cast<int>(std::wcslen(str)) * 16;
+  }
+  int fontSize() override {
+    return 16;
+  }
+  int renderText(const wchar_t* str, unsigned int color, int& width, int& height) override {
+    width = 0;
+    int lines = 1;
+    size_t length = 0;
+    for (const wchar_t* p = str;; ++p) {
+      if (*p == L'\n' || *p == 0) {
+        width = std::max(width, static_cast<int>(length) * 16);
+        length = 0;
+        if (*p == 0)break;
+        ++lines;
+      }
+      else ++length;
+    }
+    height = lines * 16;
+    if (width == 0)return -1;
+    ++counters.textsRendered;
+    return newGraph(width, height);
+  }
+  void present() override {
+    commands.clear();
+    ++counters.frames;
+    long long now = nowUs();
+    if (now < lastPresentUs + frameIntervalUs)skewUs += lastPresentUs + frameIntervalUs - now;
+    lastPresentUs = nowUs();
+  }
+};
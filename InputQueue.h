@@ -0,0 +1,170 @@
+#pragma once
+#include <vector>
+#include <array>
+#include <string>
+#include <cstring>
+#include <cstdint>
+#include "Platform.h"
+
+struct InputEvent {
+  enum Type {
+    KeyDown,
+    KeyUp,
+    PadDown,
+    PadUp,
+    // Sent while a pad direction is held, on a timer rather than per frame.
+    PadRepeat,
+    MouseMove,
+    MouseDown,
+    MouseUp,
+    // A typed character (code) from the keyboard's text input.
+    Char
+  } type;
+  // Key code, pad bit, mouse button bit or character.
+  int code;
+  int x, y;
+  long long timeUs;
+};
+
+// Turns the polled input state into a queue of timestamped events. Keys are compared eight bytes at a
+// time and only the words that changed are looked at byte by byte.
+class InputQueue {
+public:
+  // Same feel as the old 30 frame wait and 3 frame span at 60 fps.
+  static constexpr long long RepeatDelayUs = 500 * 1000;
+  static constexpr long long RepeatIntervalUs = 50 * 1000;
+  static constexpr int RepeatPads = Input::PadUp | Input::PadDown | Input::PadLeft | Input::PadRight;
+private:
+  static constexpr size_t Words = sizeof(InputState::keys) / sizeof(uint64_t);
+  std::array<uint64_t, Words> prevKeys = {};
+  int prevPad = 0;
+  int prevButtons = 0;
+  int prevX = 0, prevY = 0;
+  std::array<long long, 32> nextRepeat = {};
+  bool resyncing = true;
+  std::vector<InputEvent> queue;
+
+  void push(InputEvent::Type type, int code, int x, int y, long long timeUs) {
+    queue.push_back({ type, code, x, y, timeUs });
+  }
+  void bitEvents(int prev, int cur, InputEvent::Type down, InputEvent::Type up, int x, int y, long long nowUs) {
+    for (int changed = prev ^ cur; changed; changed &= changed - 1) {
+      int bit = changed & -changed;
+      push(cur & bit ? down : up, bit, x, y, nowUs);
+    }
+  }
+public:
+  InputQueue() {
+    queue.reserve(64);
+  }
+  // The next poll only takes over the state, so keys held across a pause do not arrive as new presses.
+  void resync() {
+    resyncing = true;
+  }
+  // Compares state with the previous poll and queues the differences, plus any auto-repeats that fell due.
+  void poll(const InputState& state, long long nowUs) {
+    queue.clear();
+    std::array<uint64_t, Words> keys;
+    memcpy(keys.data(), state.keys, sizeof keys);
+    if (resyncing) {
+      prevKeys = keys;
+      prevPad = state.joypad;
+      prevButtons = state.mouseButtons;
+      prevX = state.mouseX;
+      prevY = state.mouseY;
+      for (int i = 0; i < 32; ++i)nextRepeat[i] = nowUs + RepeatDelayUs;
+      resyncing = false;
+      return;
+    }
+    uint64_t any = 0;
+    std::array<uint64_t, Words> changed;
+    for (size_t w = 0; w < Words; ++w) {
+      changed[w] = keys[w] ^ prevKeys[w];
+      any |= changed[w];
+    }
+    if (any) {
+      for (size_t w = 0; w < Words; ++w) {
+        if (!changed[w])continue;
+        for (size_t b = w * 8; b < w * 8 + 8; ++b) {
+          if (!state.keys[b] == !reinterpret_cast<const char*>(prevKeys.data())[b])continue;
+          push(state.keys[b] ? InputEvent::KeyDown : InputEvent::KeyUp, static_cast<int>(b), state.mouseX, state.mouseY, nowUs);
+        }
+      }
+      prevKeys = keys;
+    }
+    for (wchar_t c : state.text)push(InputEvent::Char, c, state.mouseX, state.mouseY, nowUs);
+
+    if (state.mouseX != prevX || state.mouseY != prevY)
+      push(InputEvent::MouseMove, 0, state.mouseX, state.mouseY, nowUs);
+    bitEvents(prevButtons, state.mouseButtons, InputEvent::MouseDown, InputEvent::MouseUp, state.mouseX, state.mouseY, nowUs);
+    bitEvents(prevPad, state.joypad, InputEvent::PadDown, InputEvent::PadUp, state.mouseX, state.mouseY, nowUs);
+    for (int i = 0; i < 32; ++i) {
+      int bit = 1 << i;
+      if (!(RepeatPads & bit))continue;
+      if (!(state.joypad & bit) || !(prevPad & bit)) {
+        nextRepeat[i] = nowUs + RepeatDelayUs;
+        continue;
+      }
+      // A slow frame gets all the repeats that fell due since the last one, up to a limit.
+      for (int n = 0; nextRepeat[i] <= nowUs && n < 10; ++n) {
+        push(InputEvent::PadRepeat, bit, state.mouseX, state.mouseY, nextRepeat[i]);
+        nextRepeat[i] += RepeatIntervalUs;
+      }
+      if (nextRepeat[i] <= nowUs)nextRepeat[i] = nowUs + RepeatIntervalUs;
+    }
+    prevPad = state.joypad;
+    prevButtons = state.mouseButtons;
+    prevX = state.mouseX;
+    prevY = state.mouseY;
+  }
+  const std::vector<InputEvent>& events() const {
+    return queue;
+  }
+};
+
+// Input-to-selection-change latency, in buckets up to several frames.
+class LatencyHistogram {
+public:
+  static constexpr int Buckets = 10;
+  static constexpr long long Bounds[Buckets - 1] = { 250, 500, 1000, 2000, 4000, 8000, 16667, 33333, 50000 };
+private:
+  std::array<long long, Buckets> counts = {};
+  long long total = 0;
+  long long maxUs = 0;
+public:
+  void add(long long us) {
+    int i = 0;
+    while (i < Buckets - 1 && us >= Bounds[i])++i;
+    ++counts[i];
+    ++total;
+    if (us > maxUs)maxUs = us;
+  }
+  long long count() const {
+    return total;
+  }
+  long long max() const {
+    return maxUs;
+  }
+  // Upper bound of the bucket holding the p-th fraction of samples (max() for the last one).
+  long long percentile(double p) const {
+    long long seen = 0;
+    for (int i = 0; i < Buckets; ++i) {
+      seen += counts[i];
+      if (seen > 0 && seen >= p * total)return i < Buckets - 1 ? Bounds[i] : maxUs;
+    }
+    return 0;
+  }
+  // "<250us:3 <500us:10 ... >=50000us:0"
+  std::string str() const {
+    std::string s;
+    for (int i = 0; i < Buckets; ++i) {
+      if (i > 0)s += ' ';
+      s += i < Buckets - 1 ? "<" + std::to_string(Bounds[i]) : ">=" + std::to_string(Bounds[Buckets - 2]);
+      s += "us:" + std::to_string(counts[i]);
+    }
+    return s;
+  }
+  void reset() {
+    *this = LatencyHistogram();
+  }
+};
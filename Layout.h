@@ -0,0 +1,149 @@
+#pragma once
+#include <vector>
+#include <cmath>
+
+struct Rect {
+  float x1 = 0, y1 = 0, x2 = 0, y2 = 0;
+  bool contains(float x, float y) const {
+    return x1 <= x && x <= x2 && y1 <= y && y <= y2;
+  }
+};
+
+struct Triangle {
+  float x1, y1, x2, y2, x3, y3;
+};
+
+// Screen geometry of the selection grid, computed once per resolution and grid size. The 2x4 grid comes
+// out exactly as the original hand-written layout; other sizes scale the cells to fit the same area.
+class GridLayout {
+public:
+  // Rectangles of one cell, drawn at the given scale around its centre.
+  struct Cell {
+    Rect shadow, frame, icon;
+  };
+  int rows, cols;
+  int screenWidth, screenHeight;
+  int cellWidth, cellHeight;
+  int spanX, spanY;
+  int marginTop, marginLeft, marginRight, marginBottom;
+  float radiusX, radiusY;
+  int fontSize;
+  Triangle leftArrow, rightArrow;
+  Rect leftArrowHit, rightArrowHit;
+private:
+  std::vector<Cell> cells;
+  std::vector<float> centerX, centerY;
+  int (*hitTest)(const GridLayout&, int, int);
+
+  // Rows or Cols of 0 take the size from the layout; the common sizes get their own instantiation.
+  template <int Rows, int Cols>
+  static int hit(const GridLayout& l, int x, int y) {
+    const int rows = Rows ? Rows : l.rows;
+    const int cols = Cols ? Cols : l.cols;
+    int dx = x - l.marginLeft, dy = y - l.marginTop;
+    if (dx < 0 || dy < 0)return -1;
+    int pitchX = l.cellWidth + l.spanX, pitchY = l.cellHeight + l.spanY;
+    int col = pitchX > 0 ? dx / pitchX : 0, row = pitchY > 0 ? dy / pitchY : 0;
+    if (col >= cols || row >= rows)return -1;
+    if (dx - col * pitchX > l.cellWidth || dy - row * pitchY > l.cellHeight)return -1;
+    return row * cols + col;
+  }
+public:
+  GridLayout(int screenWidth, int screenHeight, int rows, int cols)
+    : rows(rows), cols(cols), screenWidth(screenWidth), screenHeight(screenHeight) {
+    cellWidth = screenWidth * 4 / (6 * cols);
+    cellHeight = screenHeight * 2 / (5 * rows);
+    marginTop = screenHeight / 20;
+    marginLeft = screenWidth / 10;
+    marginRight = screenWidth / 10;
+    marginBottom = screenHeight * 2 / 5;
+    spanX = cols > 1 ? (screenWidth - marginLeft - marginRight - cellWidth) / (cols - 1) - cellWidth : 0;
+    spanY = rows > 1 ? (screenHeight - marginTop - marginBottom - cellHeight) / (rows - 1) - cellHeight : 0;
+    radiusX = cellWidth / 8;
+    radiusY = cellHeight / 8;
+    fontSize = screenHeight / 30;
+
+    for (int y = 0; y < rows; ++y) {
+      for (int x = 0; x < cols; ++x) {
+        centerX.push_back(marginLeft + x * (cellWidth + spanX) + cellWidth / 2.f);
+        centerY.push_back(marginTop + y * (cellHeight + spanY) + cellHeight / 2.f);
+        cells.push_back(cell(static_cast<int>(cells.size()), 1.f));
+      }
+    }
+
+    float bottom = static_cast<float>(screenHeight - marginBottom);
+    leftArrow = {
+      marginLeft / 4.f, bottom / 2.f,
+      marginLeft * 3 / 4.f, bottom * 2 / 5.f,
+      marginLeft * 3 / 4.f, bottom * 3 / 5.f
+    };
+    rightArrow = {
+      screenWidth - marginLeft / 4.f, bottom / 2.f,
+      screenWidth - marginLeft * 3 / 4.f, bottom * 2 / 5.f,
+      screenWidth - marginLeft * 3 / 4.f, bottom * 3 / 5.f
+    };
+    float hitTop = (screenHeight - marginBottom - marginTop) * 2 / 5.f;
+    float hitBottom = (screenHeight - marginBottom - marginTop) * 3 / 5.f;
+    leftArrowHit = { static_cast<float>(marginLeft / 4), hitTop, static_cast<float>(marginLeft * 3 / 4), hitBottom };
+    rightArrowHit = { screenWidth - marginRight * 3 / 4.f, hitTop, screenWidth - marginRight / 4.f, hitBottom };
+
+    if (rows == 2 && cols == 4)hitTest = hit<2, 4>;
+    else if (rows == 3 && cols == 5)hitTest = hit<3, 5>;
+    else if (rows == 4 && cols == 6)hitTest = hit<4, 6>;
+    else if (rows == 6 && cols == 10)hitTest = hit<6, 10>;
+    else hitTest = hit<0, 0>;
+  }
+
+  // Size of an icon in a cell at rate 1, the size the thumbnail atlas is made for.
+  int iconWidth() const {
+    return static_cast<int>(std::lround(cells[0].icon.x2 - cells[0].icon.x1));
+  }
+  int iconHeight() const {
+    return static_cast<int>(std::lround(cells[0].icon.y2 - cells[0].icon.y1));
+  }
+  int perPage() const {
+    return rows * cols;
+  }
+  // Slot (row-major index within the page) under the point, or -1.
+  int slotAt(int x, int y) const {
+    return hitTest(*this, x, y);
+  }
+  const Cell& cell(int slot) const {
+    return cells[slot];
+  }
+  Cell cell(int slot, float rate) const {
+    float cx = centerX[slot], cy = centerY[slot];
+    Cell c;
+    c.shadow = {
+      cx - rate * cellWidth / 2.f + rate * 10,
+      cy - rate * cellHeight / 2.f + rate * 10,
+      cx + rate * cellWidth / 2.f + rate * 10,
+      cy + rate * cellHeight / 2.f + rate * 10
+    };
+    c.frame = {
+      cx - rate * cellWidth / 2.f,
+      cy - rate * cellHeight / 2.f,
+      cx + rate * cellWidth / 2.f,
+      cy + rate * cellHeight / 2.f
+    };
+    c.icon = {
+      cx - rate * (cellWidth / 2.f - cellWidth / 16.f),
+      cy - rate * (cellHeight / 2.f - cellHeight / 16.f),
+      cx + rate * (cellWidth / 2.f - cellWidth / 16.f),
+      cy + rate * (cellHeight / 2.f - cellHeight / 16.f)
+    };
+    return c;
+  }
+  // The detail image keeps its aspect ratio at the bottom right, at most half the screen wide.
+  Rect detail(int imageWidth, int imageHeight, float exrate) const {
+    float h = marginBottom - cellHeight / 2.f * exrate - 10;
+    float w = h * imageWidth / imageHeight;
+    float x = screenWidth - 5 - w;
+    float y = screenHeight - marginBottom + cellHeight / 2.f * exrate + 5;
+    if (w > screenWidth / 2.f - 10) {
+      w = screenWidth / 2.f - 10;
+      h = w * imageHeight / imageWidth;
+    }
+    return { std::floor(x), std::floor(y), std::floor(x + w), std::floor(y + h) };
+  }
+};
@@ -0,0 +1,320 @@
+#pragma once
+#include <ostream>
+#include <string>
+#include <string_view>
+#include <memory>
+#include <thread>
+#include <mutex>
+#include <atomic>
+#include <chrono>
+#include <exception>
+#include <csignal>
+#include <cstring>
+#include <cstdint>
+#include <algorithm>
+
+#ifdef _WIN32
+#include <windows.h>
+#include <io.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#else
+#include <unistd.h>
+#include <fcntl.h>
+#endif
+
+// Messages are copied into a fixed-size lock-free ring and written out by a background thread, so callers
+// never touch the stream. The writer collapses runs of similar messages, caps the number of lines written
+// per second, and everything still queued is flushed on exit and std::terminate. A fatal signal only
+// writes the messages still in the ring, as they are, to a file descriptor opened beforehand.
+struct Logger : public std::enable_shared_from_this<Logger> {
+  enum Level {
+    Error = 0,
+    Info,
+    Debug
+  };
+private:
+  static constexpr size_t Capacity = 2048;
+  static constexpr size_t TextSize = 500;
+  static constexpr int LinesPerSecond = 200;
+  static constexpr std::chrono::seconds SummaryInterval{ 5 };
+
+  struct Slot {
+    std::atomic<size_t> seq;
+    uint8_t level;
+    uint16_t length;
+    char text[TextSize];
+  };
+
+  std::basic_ostream<char>& ost;
+  std::unique_ptr<Slot[]> ring;
+  std::atomic<size_t> head = 0;
+  // Advanced by the writer only; atomic so that a signal handler can read it.
+  std::atomic<size_t> tail = 0;
+  // Where a fatal signal writes the ring: the log file opened again for appending, or stderr.
+  int crashFd = 2;
+  bool ownsCrashFd = false;
+  std::atomic<int> level = Debug;
+  std::atomic<size_t> dropped = 0;
+  std::atomic<bool> quit = false;
+  std::mutex writerMtx;
+  std::thread writer;
+  bool closed = false;
+
+  // Writer state, guarded by writerMtx.
+  uint64_t prevKey = 0;
+  uint8_t prevLevel = 0;
+  size_t similar = 0;
+  std::chrono::steady_clock::time_point similarSince;
+  std::chrono::steady_clock::time_point windowStart;
+  int windowLines = 0;
+  size_t rateSuppressed = 0;
+
+  static std::atomic<Logger*>& active() {
+    static std::atomic<Logger*> instance = nullptr;
+    return instance;
+  }
+  static const char* tag(uint8_t l) {
+    switch (l) {
+    case Error: return "[ERROR]";
+    case Info: return "[INFO]";
+    default: return "[DEBUG]";
+    }
+  }
+  // Messages that differ only in their numbers count as similar.
+  static uint64_t similarityKey(uint8_t l, const char* text, size_t n) {
+    uint64_t h = 1469598103934665603ull ^ l;
+    bool digits = false;
+    for (size_t i = 0; i < n; ++i) {
+      unsigned char c = text[i];
+      bool d = '0' <= c && c <= '9';
+      if (d && digits)continue;
+      digits = d;
+      h ^= d ? '#' : c;
+      h *= 1099511628211ull;
+    }
+    return h;
+  }
+
+  void push(Level l, const std::string& message) {
+    if (l > level.load(std::memory_order_relaxed))return;
+    size_t pos = head.load(std::memory_order_relaxed);
+    Slot* slot;
+    for (;;) {
+      slot = &ring[pos % Capacity];
+      size_t seq = slot->seq.load(std::memory_order_acquire);
+      intptr_t diff = static_cast<intptr_t>(seq) - static_cast<intptr_t>(pos);
+      if (diff == 0) {
+        if (head.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))break;
+      }
+      else if (diff < 0) {
+        dropped.fetch_add(1, std::memory_order_relaxed);
+        return;
+      }
+      else pos = head.load(std::memory_order_relaxed);
+    }
+    size_t n = std::min(message.size(), TextSize);
+    std::memcpy(slot->text, message.data(), n);
+    if (n < message.size())std::memcpy(slot->text + n - 3, "...", 3);
+    slot->level = static_cast<uint8_t>(l);
+    slot->length = static_cast<uint16_t>(n);
+    slot->seq.store(pos + 1, std::memory_order_release);
+  }
+
+  void endRun() {
+    if (similar > 0)
+      ost << tag(prevLevel) << "l̃bZ[W" << similar << "ȗ܂" << '\n';
+    similar = 0;
+  }
+  void line(uint8_t l, const char* text, size_t n, std::chrono::steady_clock::time_point now) {
+    uint64_t key = similarityKey(l, text, n);
+    if (key == prevKey && l == prevLevel) {
+      if (similar == 0)similarSince = now;
+      ++similar;
+      return;
+    }
+    endRun();
+    prevKey = key;
+    prevLevel = l;
+    if (windowLines >= LinesPerSecond) {
+      ++rateSuppressed;
+      return;
+    }
+    ++windowLines;
+    ost << tag(l);
+    ost.write(text, n);
+    ost << '\n';
+  }
+  // Drains the ring. Only one thread drains at a time (writerMtx); producers never take the lock.
+  bool drain(bool final) {
+    auto now = std::chrono::steady_clock::now();
+    if (now - windowStart >= std::chrono::seconds(1)) {
+      if (rateSuppressed > 0)
+        ost << "[INFO]o͐ɂ" << rateSuppressed << "̃bZ[Wȗ܂" << '\n';
+      rateSuppressed = 0;
+      windowLines = 0;
+      windowStart = now;
+    }
+    bool wrote = false;
+    for (size_t pos = tail.load(std::memory_order_relaxed);; ++pos) {
+      Slot& slot = ring[pos % Capacity];
+      if (slot.seq.load(std::memory_order_acquire) != pos + 1)break;
+      line(slot.level, slot.text, slot.length, now);
+      slot.seq.store(pos + Capacity, std::memory_order_release);
+      tail.store(pos + 1, std::memory_order_relaxed);
+      wrote = true;
+    }
+    if (size_t n = dropped.exchange(0, std::memory_order_relaxed)) {
+      endRun();
+      prevKey = 0;
+      ost << "[ERROR]Oobt@t̂" << n << "̃bZ[Wj܂" << '\n';
+      wrote = true;
+    }
+    if (similar > 0 && (final || now - similarSince >= SummaryInterval)) {
+      endRun();
+      prevKey = 0;
+      wrote = true;
+    }
+    if (final && rateSuppressed > 0) {
+      ost << "[INFO]o͐ɂ" << rateSuppressed << "̃bZ[Wȗ܂" << '\n';
+      rateSuppressed = 0;
+      wrote = true;
+    }
+    return wrote;
+  }
+  void run() {
+    while (!quit.load(std::memory_order_acquire)) {
+      {
+        std::lock_guard<std::mutex> lock(writerMtx);
+        if (drain(false))ost.flush();
+      }
+      std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    }
+  }
+  // std::terminate must not wait on a writer that may itself be the terminating thread.
+  static void flushActive() {
+    Logger* l = active().load();
+    if (!l)return;
+    for (int i = 0; i < 50; ++i) {
+      if (l->writerMtx.try_lock()) {
+        l->drain(true);
+        l->ost.flush();
+        l->writerMtx.unlock();
+        return;
+      }
+      std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+  }
+  static void writeRaw(int fd, const char* data, size_t n) {
+    while (n > 0) {
+#ifdef _WIN32
+      int w = _write(fd, data, static_cast<unsigned>(n));
+#else
+      ssize_t w = ::write(fd, data, n);
+#endif
+      if (w <= 0)return;
+      data += w;
+      n -= static_cast<size_t>(w);
+    }
+  }
+  // Async-signal-safe: no locks, no allocation, no streams. Lines the writer has formatted but not yet
+  // flushed are lost, and runs of similar messages are not collapsed.
+  static void dumpActive() {
+    Logger* l = active().load();
+    if (!l || l->crashFd < 0)return;
+    size_t pos = l->tail.load(std::memory_order_relaxed);
+    for (size_t i = 0; i < Capacity; ++i, ++pos) {
+      const Slot& slot = l->ring[pos % Capacity];
+      if (slot.seq.load(std::memory_order_acquire) != pos + 1)break;
+      const char* t = tag(slot.level);
+      writeRaw(l->crashFd, t, std::strlen(t));
+      writeRaw(l->crashFd, slot.text, slot.length);
+      writeRaw(l->crashFd, "\n", 1);
+    }
+  }
+#ifdef _WIN32
+  static LONG WINAPI onCrash(EXCEPTION_POINTERS*) {
+    dumpActive();
+    return EXCEPTION_CONTINUE_SEARCH;
+  }
+#endif
+  static void onSignal(int sig) {
+    dumpActive();
+    std::signal(sig, SIG_DFL);
+    std::raise(sig);
+  }
+public:
+  // crashFile should name the file ostream writes to; without it a fatal signal writes to stderr.
+  Logger(std::basic_ostream<char>& ostream, const char* crashFile = nullptr) : ost(ostream), ring(new Slot[Capacity]) {
+    if (crashFile) {
+#ifdef _WIN32
+      crashFd = _open(crashFile, _O_WRONLY | _O_APPEND | _O_CREAT | _O_BINARY | _O_NOINHERIT, _S_IREAD | _S_IWRITE);
+#else
+      crashFd = ::open(crashFile, O_WRONLY | O_APPEND | O_CREAT | O_CLOEXEC, 0644);
+#endif
+      ownsCrashFd = crashFd >= 0;
+    }
+    for (size_t i = 0; i < Capacity; ++i)ring[i].seq.store(i, std::memory_order_relaxed);
+    windowStart = std::chrono::steady_clock::now();
+    writer = std::thread([this] { run(); });
+    active().store(this);
+    static std::terminate_handler prevTerminate = std::set_terminate([] {
+      flushActive();
+      if (prevTerminate)prevTerminate();
+      std::abort();
+    });
+#ifdef _WIN32
+    SetUnhandledExceptionFilter(onCrash);
+#endif
+    std::signal(SIGSEGV, onSignal);
+    std::signal(SIGABRT, onSignal);
+    std::signal(SIGFPE, onSignal);
+  }
+  Logger(const Logger&) = delete;
+  Logger& operator=(const Logger&) = delete;
+  ~Logger() {
+    close();
+#ifdef _WIN32
+    if (ownsCrashFd)_close(crashFd);
+#else
+    if (ownsCrashFd)::close(crashFd);
+#endif
+  }
+
+  void err(const std::string& message) {
+    push(Error, message);
+  }
+  void info(const std::string& message) {
+    push(Info, message);
+  }
+  void debug(const std::string& message) {
+    push(Debug, message);
+  }
+  void setLevel(Level l) {
+    level.store(l, std::memory_order_relaxed);
+  }
+  static bool parseLevel(std::string_view name, Level& l) {
+    if (name == "error")l = Error;
+    else if (name == "info")l = Info;
+    else if (name == "debug")l = Debug;
+    else return false;
+    return true;
+  }
+  // Writes out everything queued so far on the calling thread.
+  void flush() {
+    std::lock_guard<std::mutex> lock(writerMtx);
+    drain(true);
+    ost.flush();
+  }
+  // Stops the writer and flushes. Must run before the stream is destroyed; later messages are discarded.
+  void close() {
+    if (closed)return;
+    closed = true;
+    quit.store(true, std::memory_order_release);
+    if (writer.joinable())writer.join();
+    flush();
+    level.store(-1, std::memory_order_relaxed);
+    Logger* self = this;
+    active().compare_exchange_strong(self, nullptr);
+  }
+};
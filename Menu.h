@@ -0,0 +1,586 @@
+#pragma once
+#include <vector>
+#include <string>
+#include <memory>
+#include <functional>
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+#include "Logger.h"
+#include "AssetLoader.h"
+#include "Platform.h"
+#include "Catalog.h"
+#include "TextureCache.h"
+#include "MoviePreview.h"
+#include "TextCache.h"
+#include "InputQueue.h"
+#include "Layout.h"
+#include "SearchIndex.h"
+#include "Trace.h"
+
+// The game selection screen: one call to update() reads the input, moves the selection, takes finished
+// asset loads and draws the frame into the back buffer. Presenting the frame and launching the selected
+// game are left to the caller, so the same code runs on DxLib and headless.
+// The grid shows view, the games matching the typed search query in the chosen order; positions on the
+// grid (curSelection, pages) index view, and view holds indices into games.
+class Menu {
+public:
+  enum Action {
+    None,
+    Launch
+  };
+  struct Options {
+    // Everything on the current page except the selected cell, the marquee, the arrows and a movie is drawn
+    // once into pageLayer and copied to the back buffer each frame. Without it everything is drawn every frame.
+    bool retained = true;
+    // With no input for a while the frame rate drops; animations advance by the time actually elapsed.
+    int idleAfterMs = 60 * 1000;
+    long long assetBudgetUs = 4000;
+    int statsIntervalMs = 10 * 1000;
+    int rows = 2;
+    int cols = 4;
+    // A detail movie starts once its game has been selected this long.
+    int movieDwellMs = 400;
+    // The order shown at start and after every game.
+    SearchIndex::Order order = SearchIndex::ByDifficulty;
+  };
+  struct FrameStats {
+    int frames = 0;
+    long long drawCalls = 0;
+    long long cpuUs = 0;
+    int rebuilds = 0;
+    int idleFrames = 0;
+  };
+  static constexpr int IdleFrameMs = 100;
+  // Called with the game's index when the selection moves to another game.
+  std::function<void(size_t)> onSelect;
+  // If set, every frame's input is written here in the format InputState::read() takes back.
+  std::ostream* record = nullptr;
+private:
+  static constexpr float Pi = 3.14159265f;
+  Platform& platform;
+  const Catalog& games;
+  SearchIndex& search;
+  TextureCache& textures;
+  std::shared_ptr<Logger> logger;
+  Options opt;
+  MoviePreview preview;
+  TextCache texts;
+  InputQueue input;
+  LatencyHistogram latency;
+
+  float exrate = 0.1f;
+  int curSelection = 0, prvGame = -1;
+  float selectionAngle = 0.f;
+  int curPage = 0, prvPage = 0;
+  bool pageChange = false;
+  float pageChangeAngle = 0.f;
+  float arrowAngle = 0.f;
+  int selectionX = 0;
+  int selectionY = 0;
+  GridLayout layout;
+  float infoY;
+  int pages = 0;
+
+  std::vector<uint32_t> view;
+  // Position of each game in view, or -1.
+  std::vector<int> position;
+  // The slots of the visible page, pinned in the texture cache.
+  std::vector<uint32_t> visibleSlots;
+  // Icons from the atlas by atlas page, drawn together once the cells around them are done.
+  std::vector<std::vector<Platform::Quad>> atlasQuads;
+  std::wstring query;
+  SearchIndex::Order order;
+  // Shown in place of the marquee while a query or another order is in effect.
+  std::wstring searchLabel;
+  // Title, difficulty, version and description of infoGame, formatted when the selection changes.
+  std::wstring info[4];
+  int infoGame = -1;
+
+  bool hoverLeft = false;
+  bool hoverRight = false;
+
+  float SlideTransition;
+  float SlideSpeed = 5.f;
+  const wchar_t* SlideStr = L"W#2019 }EXARg[[A̓L[{[hgăQ[Ił (NbNAX{^AEnterL[ŃQ[JnA͂ƌATabL[ŕёւ)";
+  const wchar_t* DiffiCultyStr[4] = {
+    L"<s>",
+    L"Easy(񂽂)",
+    L"Normal(ӂ)",
+    L"Hard(ނ)"
+  };
+  const wchar_t* OrderStr[SearchIndex::OrderCount] = {
+    L"Փx",
+    L"^Cg",
+    L"ߏ",
+    L"lC"
+  };
+
+  int pageLayer = -1;
+  bool sceneDirty = true;
+  long long lastInputAt;
+  // Start of the previous frame; animations advance by the time since then, in 60fps frames.
+  long long lastFrameUs;
+  bool idle_ = false;
+  FrameStats frameStats;
+  long long statsSince;
+
+  // Whether a grid index has a game in view.
+  bool in_view(int i) const {
+    return i >= 0 && static_cast<size_t>(i) < view.size();
+  }
+  void calc_selection() {
+    curSelection = curPage * layout.perPage() + selectionY * layout.cols + selectionX;
+  }
+  // Index into games of the selected game, -1 if nothing matches the query.
+  int current() const {
+    return view.empty() ? -1 : static_cast<int>(view[curSelection]);
+  }
+  void calc_pages() {
+    pages = static_cast<int>(view.size() / layout.perPage() + (view.size() % layout.perPage() ? 1 : 0));
+  }
+  // The current page and the selected detail image load first, then the neighbouring pages.
+  void prioritize_page(int page, AssetLoader::Priority p) {
+    if (page < 0 || page >= pages)return;
+    int end = std::min<int>(view.size(), (page + 1) * layout.perPage());
+    for (int i = page * layout.perPage(); i < end; ++i) {
+      textures.want(view[i] * 2, p);
+      textures.want(view[i] * 2 + 1, p == AssetLoader::Visible ? AssetLoader::Neighbor : p);
+    }
+  }
+  void pin_page(int page) {
+    visibleSlots.clear();
+    int end = std::min<int>(view.size(), (page + 1) * layout.perPage());
+    for (int i = page * layout.perPage(); i < end; ++i)visibleSlots.push_back(view[i] * 2);
+    if (!view.empty())visibleSlots.push_back(view[curSelection] * 2 + 1);
+    textures.pin(visibleSlots);
+  }
+
+  // Decodes and uploads finished reads until the frame budget is used up. A movie that becomes ready while
+  // its game is selected starts playing right away. Returns true if an icon at [pageBegin, pageEnd) or the
+  // selected game's detail image changed, i.e. the cached page has to be redrawn.
+  bool pumpAssets(int pageBegin, int pageEnd) {
+    long long start = platform.nowUs();
+    uint32_t key;
+    bool visibleChanged = false;
+    while (platform.nowUs() - start < opt.assetBudgetUs && textures.pump(key)) {
+      int index = key / 2;
+      bool isDetail = key % 2 == 1;
+      if (isDetail ? index == current() : pageBegin <= position[index] && position[index] < pageEnd)visibleChanged = true;
+    }
+    return visibleChanged;
+  }
+
+  void draw_cell(const GridLayout::Cell& cell, int index) {
+    platform.setBlend(64);
+    platform.roundRect(cell.shadow.x1, cell.shadow.y1, cell.shadow.x2, cell.shadow.y2, layout.radiusX, layout.radiusY, 0x000000, true);
+    platform.setBlend(255);
+    platform.roundRect(cell.frame.x1, cell.frame.y1, cell.frame.x2, cell.frame.y2, layout.radiusX, layout.radiusY, 0xffffff, true);
+    platform.roundRect(cell.frame.x1, cell.frame.y1, cell.frame.x2, cell.frame.y2, layout.radiusX, layout.radiusY, 0x000000, false);
+    ThumbnailAtlas::Region t;
+    if (!textures.thumb(index, t)) {
+      platform.drawGraph(cell.icon.x1, cell.icon.y1, cell.icon.x2, cell.icon.y2, textures.icon(index), true);
+      return;
+    }
+    if (atlasQuads.size() <= static_cast<size_t>(t.page))atlasQuads.resize(t.page + 1);
+    atlasQuads[t.page].push_back({ cell.icon.x1, cell.icon.y1, cell.icon.x2, cell.icon.y2, t.u1, t.v1, t.u2, t.v2 });
+  }
+  // One draw call per atlas page for the icons draw_cell() put aside.
+  void draw_atlas() {
+    for (size_t page = 0; page < atlasQuads.size(); ++page) {
+      auto& quads = atlasQuads[page];
+      if (quads.empty())continue;
+      int handle = textures.atlasPage(static_cast<int>(page));
+      if (handle != -1)platform.drawQuads(quads.data(), quads.size(), handle);
+      else
+        for (const auto& q : quads)platform.drawGraph(q.x1, q.y1, q.x2, q.y2, textures.placeholderHandle(), true);
+      quads.clear();
+    }
+  }
+  void draw_detail(bool movie) {
+    int detailWidth_, detailHeight;
+    int graph = movie ? preview.handle(current()) : textures.detail(current());
+    if (movie)platform.graphSize(graph, detailWidth_, detailHeight);
+    else textures.detailSize(current(), detailWidth_, detailHeight);
+    Rect r = layout.detail(detailWidth_, detailHeight, exrate);
+    platform.drawGraph(r.x1, r.y1, r.x2, r.y2, graph, true);
+  }
+  void draw_static(int pageBegin, int pageEnd, bool movie) {
+    for (int i = pageBegin; i < pageEnd; ++i)
+      if (i != curSelection)draw_cell(layout.cell(i - pageBegin), view[i]);
+    draw_atlas();
+    int game = current();
+    if (game != infoGame) {
+      info[0] = std::wstring(L"^Cg@F").append(games.title(game));
+      info[1] = std::wstring(L"Փx@@F") + DiffiCultyStr[games.difficulty(game) + 1];
+      info[2] = std::wstring(L"o[WF").append(games.version(game));
+      info[3] = std::wstring(L"F\n").append(games.description(game));
+      infoGame = game;
+    }
+    for (int i = 0; i < 4; ++i)texts.draw(0, infoY + layout.fontSize * i, 0xff0000, info[i]);
+    if (!movie)draw_detail(false);
+  }
+  void draw_arrows() {
+    float transition = std::sin(arrowAngle) * 5.f;
+    if (curPage > 0) {
+      const Triangle& t = layout.leftArrow;
+      if (hoverLeft)
+        platform.triangle(t.x1 - transition, t.y1, t.x2 - transition, t.y2, t.x3 - transition, t.y3, 0xff0000, true);
+      platform.triangle(t.x1 - transition, t.y1, t.x2 - transition, t.y2, t.x3 - transition, t.y3, 0x000000, false);
+    }
+    if (curPage < pages - 1) {
+      const Triangle& t = layout.rightArrow;
+      if (hoverRight)
+        platform.triangle(t.x1 + transition, t.y1, t.x2 + transition, t.y2, t.x3 + transition, t.y3, 0xff0000, true);
+      platform.triangle(t.x1 + transition, t.y1, t.x2 + transition, t.y2, t.x3 + transition, t.y3, 0x000000, false);
+    }
+  }
+
+  void move_left() {
+    if (--selectionX < 0) {
+      if (curPage > 0) {
+        --curPage;
+        selectionX = layout.cols - 1;
+      }
+      else selectionX = 0;
+    }
+  }
+  void move_right() {
+    if (++selectionX >= layout.cols) {
+      if (curPage < pages - 1) {
+        ++curPage;
+        selectionX = 0;
+        calc_selection();
+        while (!in_view(curSelection)) {
+          --selectionY;
+          calc_selection();
+        }
+      }
+      else selectionX = layout.cols - 1;
+    }
+    calc_selection();
+    if (!in_view(curSelection))
+      --selectionX;
+  }
+  void move_up() {
+    if (selectionY > 0)--selectionY;
+  }
+  void move_down() {
+    if (selectionY < layout.rows - 1)++selectionY;
+    calc_selection();
+    if (!in_view(curSelection))--selectionY;
+  }
+  void hover(int mouseX, int mouseY) {
+    hoverLeft = layout.leftArrowHit.contains(mouseX, mouseY);
+    hoverRight = layout.rightArrowHit.contains(mouseX, mouseY);
+  }
+  void point(int mouseX, int mouseY) {
+    int slot = layout.slotAt(mouseX, mouseY);
+    if (slot < 0 || !in_view(curPage * layout.perPage() + slot))return;
+    selectionX = slot % layout.cols;
+    selectionY = slot / layout.cols;
+  }
+  // Runs the query again and starts over from the first match.
+  void apply_search() {
+    for (int d = -1; d <= 1; ++d)prioritize_page(curPage + d, AssetLoader::Background);
+    search.query(query, order, view);
+    position.assign(games.size(), -1);
+    for (size_t i = 0; i < view.size(); ++i)position[view[i]] = static_cast<int>(i);
+    calc_pages();
+    curPage = 0;
+    selectionX = 0;
+    selectionY = 0;
+    curSelection = 0;
+    prvPage = -1;
+    sceneDirty = true;
+    label();
+  }
+  void label() {
+    searchLabel.clear();
+    if (!query.empty() || order != opt.order)
+      searchLabel = L"F" + query + L"@(" + std::to_wstring(view.size()) + L", " + OrderStr[order] + L")";
+  }
+  // Typed characters edit the query; backspace deletes one, escape clears it and tab switches the order.
+  void type(wchar_t c) {
+    if (c == Input::CharBack) {
+      if (query.empty())return;
+      query.pop_back();
+    }
+    else if (c == Input::CharEscape) {
+      if (query.empty())return;
+      query.clear();
+    }
+    else if (c == Input::CharTab)order = static_cast<SearchIndex::Order>((order + 1) % SearchIndex::OrderCount);
+    else if (c >= 0x20)query += c;
+    else return;
+    apply_search();
+  }
+  // Applies one event to the selection. Returns true if it confirms the selected game.
+  bool handle(const InputEvent& e) {
+    switch (e.type) {
+    case InputEvent::PadDown:
+      if (e.code == Input::PadX)return !view.empty();
+      [[fallthrough]];
+    case InputEvent::PadRepeat:
+      if (e.code == Input::PadLeft)move_left();
+      else if (e.code == Input::PadRight)move_right();
+      else if (e.code == Input::PadUp)move_up();
+      else if (e.code == Input::PadDown)move_down();
+      break;
+    case InputEvent::KeyDown:
+      if (e.code == Input::KeyReturn)return !view.empty();
+      break;
+    case InputEvent::Char:
+      type(static_cast<wchar_t>(e.code));
+      break;
+    case InputEvent::MouseMove:
+      hover(e.x, e.y);
+      point(e.x, e.y);
+      break;
+    case InputEvent::MouseDown:
+      if (e.code != Input::MouseLeft)break;
+      hover(e.x, e.y);
+      if (hoverLeft && curPage > 0) {
+        --curPage;
+        selectionX = selectionY = 0;
+      }
+      else if (hoverRight && curPage < pages - 1) {
+        ++curPage;
+        selectionX = selectionY = 0;
+      }
+      else if (!view.empty() && layout.slotAt(e.x, e.y) == selectionY * layout.cols + selectionX)return true;
+      break;
+    default:
+      break;
+    }
+    return false;
+  }
+public:
+  Menu(Platform& platform, const Catalog& games, SearchIndex& search, TextureCache& textures,
+    std::shared_ptr<Logger> logger, int screenWidth, int screenHeight, Options options)
+    : platform(platform), games(games), search(search), textures(textures), logger(logger), opt(options)
+    , preview(platform, games, textures, logger, options.movieDwellMs), texts(platform)
+    , layout(screenWidth, screenHeight, std::max(options.rows, 1), std::max(options.cols, 1)), order(options.order) {
+    apply_search();
+    resize(screenWidth, screenHeight, options.rows, options.cols);
+    if (opt.retained)pageLayer = platform.makeScreen(layout.screenWidth, layout.screenHeight);
+    lastInputAt = statsSince = platform.nowUs() / 1000;
+    lastFrameUs = platform.nowUs();
+  }
+  Menu(const Menu&) = delete;
+  Menu& operator=(const Menu&) = delete;
+  ~Menu() {
+    if (pageLayer != -1)platform.deleteGraph(pageLayer);
+  }
+
+  // Index into games of the selected game, -1 if nothing matches the query.
+  int selection() const {
+    return current();
+  }
+  // Recomputes the layout for a new resolution or grid size, keeping the selected game.
+  void resize(int screenWidth, int screenHeight, int rows, int cols) {
+    layout = GridLayout(screenWidth, screenHeight, std::max(rows, 1), std::max(cols, 1));
+    infoY = screenHeight - layout.marginBottom + layout.cellHeight / 2.f * exrate;
+    calc_pages();
+    SlideTransition = screenWidth;
+    curPage = curSelection / layout.perPage();
+    selectionY = curSelection % layout.perPage() / layout.cols;
+    selectionX = curSelection % layout.cols;
+    prvPage = -1;
+    if (pageLayer != -1) {
+      platform.deleteGraph(pageLayer);
+      pageLayer = platform.makeScreen(screenWidth, screenHeight);
+    }
+    sceneDirty = true;
+  }
+  bool idle() const {
+    return idle_;
+  }
+  // Time from an input event to the end of the frame that shows the selection it moved to.
+  const LatencyHistogram& inputLatency() const {
+    return latency;
+  }
+  const MoviePreview& movies() const {
+    return preview;
+  }
+  // The catalog was changed in place and the search index updated; changed lists the games added, changed
+  // or removed. The query and order stay, and so does the selected game, or its position if it is gone.
+  // After a rebuild (rebuilt) ids no longer name the same games, so the selection starts over.
+  void refresh(const std::vector<uint32_t>& changed, bool rebuilt = false) {
+    textures.grow();
+    preview.grow();
+    if (rebuilt) {
+      preview.closeAll();
+      preview.reset();
+      curSelection = 0;
+      prvGame = -1;
+    }
+    else
+      for (uint32_t game : changed) {
+        textures.invalidate(game);
+        preview.invalidate(game);
+      }
+    int selected = rebuilt ? -1 : current();
+    infoGame = -1;
+    search.query(query, order, view);
+    position.assign(games.size(), -1);
+    for (size_t i = 0; i < view.size(); ++i)position[view[i]] = static_cast<int>(i);
+    calc_pages();
+    int slot = selected >= 0 && static_cast<size_t>(selected) < position.size() && position[selected] >= 0 ? position[selected] : std::min(curSelection, static_cast<int>(view.size()) - 1);
+    curSelection = std::max(slot, 0);
+    curPage = curSelection / layout.perPage();
+    selectionY = curSelection % layout.perPage() / layout.cols;
+    selectionX = curSelection % layout.cols;
+    prvPage = -1;
+    sceneDirty = true;
+    label();
+  }
+  // Releases the page layer, the movies and the rendered text while a game runs.
+  void suspend() {
+    preview.closeAll();
+    texts.clear();
+    if (pageLayer != -1)platform.deleteGraph(pageLayer);
+    pageLayer = -1;
+  }
+  // Back from a game: the query is cleared and the selection starts over from the first game.
+  void resume() {
+    if (opt.retained)pageLayer = platform.makeScreen(layout.screenWidth, layout.screenHeight);
+    sceneDirty = true;
+    lastInputAt = platform.nowUs() / 1000;
+    lastFrameUs = platform.nowUs();
+    // Keys still held from before the game (Enter) must not count as new presses.
+    input.resync();
+    query.clear();
+    order = opt.order;
+    apply_search();
+  }
+
+  Action update() {
+    TraceSpan span("update");
+    long long frameStart = platform.nowUs();
+    size_t drawCallsBefore = platform.drawCalls;
+    InputState state;
+    platform.readInput(state);
+    if (record)state.write(*record);
+    input.poll(state, frameStart);
+
+    long long now = frameStart / 1000;
+    if (!input.events().empty() || state.anyKey() || state.joypad != 0 || state.mouseButtons != 0)lastInputAt = now;
+    if (idle_ != (now - lastInputAt >= opt.idleAfterMs)) {
+      idle_ = !idle_;
+      logger->info(idle_ ? "ACh[hɈڍs܂" : "ACh[h܂");
+    }
+    // Capped so that a stall (a slow disk, a dragged window) does not make everything jump.
+    float step = std::clamp((frameStart - lastFrameUs) / (1000000.f / 60), 0.f, 2.f * IdleFrameMs / (1000.f / 60));
+    lastFrameUs = frameStart;
+
+    // The earliest event that moved the selection this frame, for the latency histogram.
+    long long changedAt = -1;
+    for (const InputEvent& e : input.events()) {
+      int selected = current(), page = curPage;
+      if (handle(e))return Launch;
+      calc_selection();
+      if (changedAt < 0 && (current() != selected || curPage != page))changedAt = e.timeUs;
+    }
+    hover(state.mouseX, state.mouseY);
+
+    int selected = current();
+    if (prvGame != selected)selectionAngle = 0.f;
+
+    if (prvPage != curPage) {
+      pageChangeAngle = 0.f;
+      pageChange = true;
+    }
+    if (pageChange && pageChangeAngle < Pi)
+      pageChangeAngle += Pi / 30 * step;
+    else pageChange = false;
+
+    if (prvGame != selected) {
+      if (selected >= 0 && onSelect)onSelect(selected);
+      preview.select(selected, frameStart);
+    }
+
+    if (prvGame != selected || prvPage != curPage) {
+      sceneDirty = true;
+      if (prvGame >= 0)
+        for (int d = -1; d <= 1; ++d)prioritize_page(prvPage + d, AssetLoader::Background);
+      for (int d = -1; d <= 1; ++d)prioritize_page(curPage + d, d == 0 ? AssetLoader::Visible : AssetLoader::Neighbor);
+      if (selected >= 0)textures.want(selected * 2 + 1, AssetLoader::Visible);
+      pin_page(curPage);
+    }
+
+    prvGame = selected;
+    prvPage = curPage;
+    calc_selection();
+
+    int pageBegin = curPage * layout.perPage();
+    int pageEnd = std::min<int>(view.size(), pageBegin + layout.perPage());
+    if (pumpAssets(pageBegin, pageEnd))sceneDirty = true;
+    if (preview.update(frameStart))sceneDirty = true;
+
+    SlideTransition -= SlideSpeed * step;
+    if (SlideTransition < -texts.width(SlideStr, 0x000000))
+      SlideTransition = layout.screenWidth;
+
+    TraceSpan drawSpan("draw");
+    bool movie = selected >= 0 && preview.handle(selected) != -1;
+    if (selected < 0) {
+      platform.clear();
+      texts.draw(0, infoY, 0xff0000, L"YQ[܂");
+    }
+    else if (opt.retained) {
+      if (sceneDirty) {
+        platform.setDrawScreen(pageLayer);
+        platform.clear();
+        draw_static(pageBegin, pageEnd, movie);
+        platform.setDrawScreen(-1);
+        sceneDirty = false;
+        ++frameStats.rebuilds;
+      }
+      platform.drawGraph(0, 0, layout.screenWidth, layout.screenHeight, pageLayer, false);
+    }
+    else {
+      platform.clear();
+      draw_static(pageBegin, pageEnd, movie);
+    }
+
+    if (searchLabel.empty())texts.draw(SlideTransition, 0, 0x000000, SlideStr);
+    else texts.draw(0, 0, 0x000000, searchLabel);
+    if (selected >= 0) {
+      draw_cell(layout.cell(curSelection - pageBegin, 1.f + std::sin(selectionAngle) * exrate), selected);
+      draw_atlas();
+      if (movie)draw_detail(true);
+    }
+    selectionAngle += Pi / 30 * step;
+    arrowAngle += Pi / 10 * step;
+    draw_arrows();
+
+    if (changedAt >= 0)latency.add(platform.nowUs() - changedAt);
+    Trace::counter("draw calls", static_cast<long long>(platform.drawCalls - drawCallsBefore));
+    Trace::counter("texture KB", static_cast<long long>(textures.stats().residentBytes >> 10));
+    ++frameStats.frames;
+    frameStats.drawCalls += platform.drawCalls - drawCallsBefore;
+    frameStats.cpuUs += platform.nowUs() - frameStart;
+    if (idle_)++frameStats.idleFrames;
+    if (opt.statsIntervalMs > 0 && now - statsSince >= opt.statsIntervalMs) {
+      logger->debug(
+        std::string(opt.retained ? "`擝v(LbV)F" : "`擝v(t[`)F") + std::to_string(frameStats.frames) + "t[, "
+        + "ϕ`R[" + std::to_string(frameStats.drawCalls / frameStats.frames) + ", "
+        + "CPU" + std::to_string(frameStats.cpuUs / frameStats.frames) + "us, "
+        + "ĕ`" + std::to_string(frameStats.rebuilds) + ", ACh" + std::to_string(frameStats.idleFrames) + "t["
+      );
+      logger->debug("eNX`F" + textures.str());
+      if (latency.count() > 0)
+        logger->debug(
+          "͒xF" + std::to_string(latency.count()) + ", l" + std::to_string(latency.percentile(0.5))
+          + "usȉ, 99%" + std::to_string(latency.percentile(0.99)) + "usȉ, ő" + std::to_string(latency.max()) + "us ["
+          + latency.str() + "]"
+        );
+      latency.reset();
+      frameStats = FrameStats();
+      statsSince = now;
+    }
+    return None;
+  }
+};
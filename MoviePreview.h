@@ -0,0 +1,141 @@
+#pragma once
+#include <memory>
+#include <vector>
+#include <algorithm>
+#include <cstdint>
+
+#include "Logger.h"
+#include "Platform.h"
+#include "Catalog.h"
+#include "TextureCache.h"
+
+// Plays the detail movie of the selected game. A movie is only opened once its game has stayed selected
+// for the dwell time, and opening happens in the background; at most MaxOpen movies are open at a time,
+// so the number of decoders and file handles does not grow with the number of movie games. Until
+// playback starts the detail slot shows the poster: the frame the movie was left at the last time it
+// played, or the placeholder before that.
+class MoviePreview {
+public:
+  static constexpr size_t MaxOpen = 2;
+  struct Stats {
+    size_t opens = 0;
+    size_t maxOpen = 0;
+  };
+private:
+  struct Open {
+    int game;
+    int handle;
+    long long usedAt;
+  };
+  Platform& platform;
+  const Catalog& games;
+  TextureCache& textures;
+  std::shared_ptr<Logger> logger;
+  long long dwellUs;
+  std::vector<Open> open;
+  // Games whose movie could not be opened; they keep showing the poster.
+  std::vector<uint8_t> failed;
+  int selected = -1;
+  long long selectedAt = 0;
+  int playingGame = -1;
+  int playingHandle = -1;
+  Stats counters;
+
+  void close(size_t i) {
+    platform.deleteGraph(open[i].handle);
+    open.erase(open.begin() + i);
+  }
+  void fail(int game) {
+    logger->err(games.detail(game).string() + "J܂ł");
+    failed[game] = 1;
+  }
+  // Pauses the playing movie and keeps its current frame as the poster.
+  void stop() {
+    if (playingHandle == -1)return;
+    platform.pauseMovie(playingHandle);
+    if (auto poster = platform.capture(playingHandle))textures.setPoster(playingGame, poster);
+    playingGame = playingHandle = -1;
+  }
+public:
+  MoviePreview(Platform& platform, const Catalog& games, TextureCache& textures, std::shared_ptr<Logger> logger, int dwellMs)
+    : platform(platform), games(games), textures(textures), logger(logger), dwellUs(dwellMs * 1000LL), failed(games.size()) {
+    open.reserve(MaxOpen);
+  }
+  MoviePreview(const MoviePreview&) = delete;
+  MoviePreview& operator=(const MoviePreview&) = delete;
+
+  void select(int game, long long nowUs) {
+    if (game == selected)return;
+    stop();
+    selected = game;
+    selectedAt = nowUs;
+  }
+  // Opens and starts the selected game's movie once the dwell time has passed and the movie has loaded.
+  // Returns true on the frame playback starts.
+  bool update(long long nowUs) {
+    if (selected < 0 || selected == playingGame || !games.isMovie(selected) || failed[selected])return false;
+    if (nowUs - selectedAt < dwellUs)return false;
+    size_t i = 0;
+    while (i < open.size() && open[i].game != selected)++i;
+    if (i == open.size()) {
+      if (open.size() >= MaxOpen) {
+        size_t oldest = 0;
+        for (size_t j = 1; j < open.size(); ++j)
+          if (open[j].usedAt < open[oldest].usedAt)oldest = j;
+        close(oldest);
+      }
+      int handle = platform.openMovie(games.detail(selected));
+      if (handle == -1) {
+        fail(selected);
+        return false;
+      }
+      open.push_back({ selected, handle, nowUs });
+      i = open.size() - 1;
+      ++counters.opens;
+      counters.maxOpen = std::max(counters.maxOpen, open.size());
+    }
+    open[i].usedAt = nowUs;
+    int status = platform.loadStatus(open[i].handle);
+    if (status == 1)return false;
+    if (status == -1) {
+      fail(selected);
+      close(i);
+      return false;
+    }
+    playingGame = selected;
+    playingHandle = open[i].handle;
+    platform.playMovie(playingHandle, true);
+    return true;
+  }
+  // The movie to draw for the game, -1 while the poster is shown instead.
+  int handle(int game) const {
+    return game == playingGame ? playingHandle : -1;
+  }
+  // Closes every movie, e.g. while a game runs. The next selection opens them again.
+  void closeAll() {
+    stop();
+    while (!open.empty())close(open.size() - 1);
+    selected = -1;
+  }
+  // Makes room for games added to the catalog.
+  void grow() {
+    failed.resize(games.size(), 0);
+  }
+  // The game's files changed: its movie is closed and opened again the next time it is wanted.
+  void invalidate(int game) {
+    if (playingGame == game)playingGame = playingHandle = -1;
+    for (size_t i = open.size(); i-- > 0;)
+      if (open[i].game == game)close(i);
+    failed[game] = 0;
+  }
+  // The catalog was rebuilt.
+  void reset() {
+    playingGame = playingHandle = -1;
+    while (!open.empty())close(open.size() - 1);
+    selected = -1;
+    failed.assign(games.size(), 0);
+  }
+  Stats stats() const {
+    return counters;
+  }
+};
@@ -0,0 +1,389 @@
+#pragma once
+#include <filesystem>
+#include <fstream>
+#include <string>
+#include <string_view>
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <chrono>
+#include <algorithm>
+#include <ctime>
+#include <cstdint>
+#include <cstring>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <cerrno>
+#endif
+
+namespace fs = std::filesystem;
+
+// Collects what a launched game writes to stdout and stderr. Both go to pipes that a reader thread drains
+// as soon as data arrives (epoll on Linux, overlapped reads of named pipes on Windows) into a ring buffer,
+// and a writer thread appends the ring to the game's log file. The log is rotated once it reaches
+// fileBytes: game.log becomes game.1.log and so on, keeping `files` of them. The reader never waits for
+// the disk; when the ring is full, output is left out of the log and counted as dropped, so a game that
+// writes heavily never blocks on a full pipe. The last tailBytes are kept in memory as well, for the error
+// screen. The buffers are allocated once and reused for every launch; nothing is allocated per line.
+class OutputCapture {
+public:
+  struct Options {
+    size_t fileBytes = 1 << 20;
+    int files = 3;
+    size_t ringBytes = 256 << 10;
+    size_t tailBytes = 4 << 10;
+  };
+  struct Stats {
+    uint64_t bytes = 0;
+    uint64_t dropped = 0;
+    size_t rotations = 0;
+  };
+  static constexpr int Streams = 2;
+#ifdef _WIN32
+  using Handle = HANDLE;
+#else
+  using Handle = int;
+#endif
+private:
+  static constexpr size_t ChunkBytes = 64 << 10;
+  Options opt;
+  Handle readers[Streams], writers[Streams];
+  std::vector<char> chunks[Streams];
+  // Output not written to the log yet, ringSize bytes from ringStart.
+  std::vector<char> ring;
+  size_t ringStart = 0, ringSize = 0;
+  std::vector<char> tailRing;
+  size_t tailStart = 0, tailSize = 0;
+  mutable std::mutex mtx;
+  std::condition_variable pending, done;
+  bool readerDone = true, writerStop = false;
+  Stats counters;
+  fs::path logFile;
+  std::ofstream log;
+  uint64_t logSize = 0;
+  std::thread reader, writer;
+#ifdef _WIN32
+  HANDLE stopEvent = NULL;
+#else
+  int stopFd = -1;
+#endif
+
+  static bool valid(Handle h) {
+#ifdef _WIN32
+    return h != INVALID_HANDLE_VALUE;
+#else
+    return h >= 0;
+#endif
+  }
+  static void close(Handle& h) {
+    if (!valid(h))return;
+#ifdef _WIN32
+    CloseHandle(h);
+    h = INVALID_HANDLE_VALUE;
+#else
+    ::close(h);
+    h = -1;
+#endif
+  }
+  // Copies data to the end of a ring of which size bytes from start are in use, as far as there is room.
+  static size_t append(std::vector<char>& r, size_t start, size_t& size, const char* data, size_t n) {
+    n = std::min(n, r.size() - size);
+    size_t at = (start + size) % r.size();
+    size_t first = std::min(n, r.size() - at);
+    std::memcpy(r.data() + at, data, first);
+    std::memcpy(r.data(), data + first, n - first);
+    size += n;
+    return n;
+  }
+  void push(const char* data, size_t n) {
+    {
+      std::lock_guard<std::mutex> lock(mtx);
+      counters.bytes += n;
+      counters.dropped += n - append(ring, ringStart, ringSize, data, n);
+      // Keeps the newest tailBytes.
+      size_t keep = std::min(n, tailRing.size());
+      size_t drop = tailSize + keep > tailRing.size() ? tailSize + keep - tailRing.size() : 0;
+      tailStart = (tailStart + drop) % tailRing.size();
+      tailSize -= drop;
+      append(tailRing, tailStart, tailSize, data + n - keep, keep);
+    }
+    pending.notify_one();
+  }
+
+  fs::path rotated(int i) const {
+    if (i == 0)return logFile;
+    fs::path p = logFile;
+    return p.replace_extension("." + std::to_string(i) + logFile.extension().string());
+  }
+  void rotate() {
+    log.close();
+    std::error_code ec;
+    for (int i = opt.files - 1; i > 0; --i)fs::rename(rotated(i - 1), rotated(i), ec);
+    log.open(logFile, std::ios::binary | std::ios::trunc);
+    logSize = 0;
+    std::lock_guard<std::mutex> lock(mtx);
+    ++counters.rotations;
+  }
+  void write(const char* data, size_t n) {
+    while (n > 0 && log.is_open()) {
+      if (logSize >= opt.fileBytes) {
+        rotate();
+        continue;
+      }
+      size_t k = static_cast<size_t>(std::min<uint64_t>(n, opt.fileBytes - logSize));
+      log.write(data, k);
+      logSize += k;
+      data += k;
+      n -= k;
+    }
+  }
+  void writeLoop() {
+    std::unique_lock<std::mutex> lock(mtx);
+    for (;;) {
+      pending.wait(lock, [this] { return ringSize > 0 || writerStop; });
+      if (ringSize == 0)break;
+      // The reader only appends behind ringSize, so this part stays put while it is written.
+      size_t start = ringStart, n = std::min(ringSize, ring.size() - ringStart);
+      lock.unlock();
+      write(ring.data() + start, n);
+      log.flush();
+      lock.lock();
+      ringStart = (ringStart + n) % ring.size();
+      ringSize -= n;
+    }
+  }
+
+#ifdef _WIN32
+  // Anonymous pipes cannot be read with overlapped I/O, so each stream is a named pipe of its own.
+  bool pipe(int s) {
+    static std::atomic<unsigned> serial = 0;
+    std::wstring name = L"\\\\.\\pipe\\launcher-output-" + std::to_wstring(GetCurrentProcessId()) + L"-" + std::to_wstring(serial++);
+    readers[s] = CreateNamedPipeW(name.c_str(), PIPE_ACCESS_INBOUND | FILE_FLAG_OVERLAPPED | FILE_FLAG_FIRST_PIPE_INSTANCE,
+      PIPE_TYPE_BYTE | PIPE_WAIT | PIPE_REJECT_REMOTE_CLIENTS, 1, 0, static_cast<DWORD>(ChunkBytes), 0, NULL);
+    if (readers[s] == INVALID_HANDLE_VALUE)return false;
+    SECURITY_ATTRIBUTES sa = { sizeof sa, NULL, TRUE };
+    writers[s] = CreateFileW(name.c_str(), GENERIC_WRITE, 0, &sa, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+    return writers[s] != INVALID_HANDLE_VALUE;
+  }
+  bool arm(int s, OVERLAPPED& ov) {
+    // Also signals the event when it completes at once.
+    if (ReadFile(readers[s], chunks[s].data(), static_cast<DWORD>(chunks[s].size()), NULL, &ov))return true;
+    return GetLastError() == ERROR_IO_PENDING;
+  }
+  void readLoop() {
+    OVERLAPPED ov[Streams] = {};
+    HANDLE events[Streams + 1];
+    bool open[Streams];
+    int left = 0;
+    for (int s = 0; s < Streams; ++s) {
+      events[s] = CreateEventW(NULL, TRUE, FALSE, NULL);
+      ov[s].hEvent = events[s];
+      open[s] = arm(s, ov[s]);
+      if (open[s])++left;
+      else ResetEvent(events[s]);
+    }
+    events[Streams] = stopEvent;
+    while (left > 0) {
+      DWORD w = WaitForMultipleObjects(Streams + 1, events, FALSE, INFINITE);
+      if (w < WAIT_OBJECT_0 || w >= WAIT_OBJECT_0 + Streams)break;
+      int s = static_cast<int>(w - WAIT_OBJECT_0);
+      DWORD n = 0;
+      // Fails with ERROR_BROKEN_PIPE once the game, and whatever it started, closed its end.
+      if (GetOverlappedResult(readers[s], &ov[s], &n, FALSE)) {
+        push(chunks[s].data(), n);
+        if (arm(s, ov[s]))continue;
+      }
+      open[s] = false;
+      ResetEvent(events[s]);
+      --left;
+    }
+    for (int s = 0; s < Streams; ++s) {
+      DWORD n;
+      // The read has to end before its buffer and event go away.
+      if (open[s] && CancelIoEx(readers[s], &ov[s]))GetOverlappedResult(readers[s], &ov[s], &n, TRUE);
+      CloseHandle(events[s]);
+    }
+  }
+#else
+  bool pipe(int s) {
+    int fds[2];
+    if (pipe2(fds, O_CLOEXEC) != 0)return false;
+    readers[s] = fds[0];
+    writers[s] = fds[1];
+    fcntl(readers[s], F_SETFL, fcntl(readers[s], F_GETFL) | O_NONBLOCK);
+    // A larger pipe absorbs bursts while the reader is not scheduled.
+    fcntl(readers[s], F_SETPIPE_SZ, static_cast<int>(ChunkBytes));
+    return true;
+  }
+  void readLoop() {
+    int ep = epoll_create1(EPOLL_CLOEXEC);
+    if (ep < 0)return;
+    epoll_event ev = {};
+    ev.events = EPOLLIN;
+    for (int s = 0; s <= Streams; ++s) {
+      ev.data.u32 = static_cast<uint32_t>(s);
+      epoll_ctl(ep, EPOLL_CTL_ADD, s < Streams ? readers[s] : stopFd, &ev);
+    }
+    for (int left = Streams; left > 0;) {
+      epoll_event events[Streams + 1];
+      int n = epoll_wait(ep, events, Streams + 1, -1);
+      if (n < 0 && errno == EINTR)continue;
+      if (n < 0)break;
+      bool stop = false;
+      for (int i = 0; i < n; ++i) {
+        int s = static_cast<int>(events[i].data.u32);
+        if (s == Streams) {
+          stop = true;
+          continue;
+        }
+        // One read per wakeup, so that neither stream starves the other.
+        ssize_t r = ::read(readers[s], chunks[s].data(), chunks[s].size());
+        if (r > 0)push(chunks[s].data(), static_cast<size_t>(r));
+        else if (r == 0 || (errno != EAGAIN && errno != EINTR)) {
+          epoll_ctl(ep, EPOLL_CTL_DEL, readers[s], nullptr);
+          --left;
+        }
+      }
+      if (stop)break;
+    }
+    ::close(ep);
+  }
+#endif
+public:
+  explicit OutputCapture(Options options) : opt(options) {
+    opt.files = std::max(1, opt.files);
+    for (int s = 0; s < Streams; ++s) {
+#ifdef _WIN32
+      readers[s] = writers[s] = INVALID_HANDLE_VALUE;
+#else
+      readers[s] = writers[s] = -1;
+#endif
+      chunks[s].resize(ChunkBytes);
+    }
+    ring.resize(std::max<size_t>(opt.ringBytes, 1));
+    tailRing.resize(std::max<size_t>(opt.tailBytes, 1));
+#ifdef _WIN32
+    stopEvent = CreateEventW(NULL, TRUE, FALSE, NULL);
+#else
+    stopFd = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+#endif
+  }
+  OutputCapture(const OutputCapture&) = delete;
+  OutputCapture& operator=(const OutputCapture&) = delete;
+  ~OutputCapture() {
+    finish(std::chrono::milliseconds(0));
+#ifdef _WIN32
+    if (stopEvent != NULL)CloseHandle(stopEvent);
+#else
+    if (stopFd >= 0)::close(stopFd);
+#endif
+  }
+
+  // Creates the pipes and starts reading them. The output is appended to file after a line giving the
+  // time and title; without the log file it is still read and kept as the tail.
+  bool open(const fs::path& file, std::string_view title) {
+    finish(std::chrono::milliseconds(0));
+    for (int s = 0; s < Streams; ++s)
+      if (!pipe(s)) {
+        for (int t = 0; t <= s; ++t) {
+          close(readers[t]);
+          close(writers[t]);
+        }
+        return false;
+      }
+    counters = Stats();
+    ringStart = ringSize = tailStart = tailSize = 0;
+    readerDone = writerStop = false;
+#ifdef _WIN32
+    ResetEvent(stopEvent);
+#else
+    uint64_t drained;
+    while (::read(stopFd, &drained, sizeof(drained)) > 0) {}
+#endif
+    logFile = file;
+    std::error_code ec;
+    fs::create_directories(logFile.parent_path(), ec);
+    logSize = fs::file_size(logFile, ec);
+    if (ec)logSize = 0;
+    log.open(logFile, std::ios::binary | std::ios::app);
+    std::time_t now = std::time(nullptr);
+    std::tm tm = {};
+#ifdef _WIN32
+    localtime_s(&tm, &now);
+#else
+    localtime_r(&now, &tm);
+#endif
+    char stamp[32];
+    std::strftime(stamp, sizeof(stamp), "%Y-%m-%d %H:%M:%S", &tm);
+    std::string banner = std::string(logSize > 0 ? "\n" : "") + "==== " + stamp + " " + std::string(title) + " ====\n";
+    write(banner.data(), banner.size());
+    log.flush();
+
+    writer = std::thread([this] { writeLoop(); });
+    reader = std::thread([this] {
+      readLoop();
+      std::lock_guard<std::mutex> lock(mtx);
+      readerDone = true;
+      done.notify_all();
+    });
+    return true;
+  }
+  // The write end of a stream (0 for stdout, 1 for stderr), to be inherited by the game.
+  Handle output(int stream) const {
+    return writers[stream];
+  }
+  // Closes this process's write ends once the game holds its own, so that the reader sees the end of the
+  // output when the game exits.
+  void closeOutputs() {
+    for (int s = 0; s < Streams; ++s)close(writers[s]);
+  }
+  // Waits at most timeout for the end of the output (a process the game started may keep the pipes open),
+  // then stops reading and writes out what is left.
+  void finish(std::chrono::milliseconds timeout) {
+    if (!reader.joinable())return;
+    closeOutputs();
+    {
+      std::unique_lock<std::mutex> lock(mtx);
+      done.wait_for(lock, timeout, [this] { return readerDone; });
+    }
+#ifdef _WIN32
+    SetEvent(stopEvent);
+#else
+    uint64_t one = 1;
+    if (::write(stopFd, &one, sizeof(one)) < 0) {}
+#endif
+    reader.join();
+    for (int s = 0; s < Streams; ++s)close(readers[s]);
+    {
+      std::lock_guard<std::mutex> lock(mtx);
+      writerStop = true;
+    }
+    pending.notify_all();
+    writer.join();
+    log.close();
+  }
+  // The newest output, at most tailBytes.
+  std::string tail() const {
+    std::lock_guard<std::mutex> lock(mtx);
+    std::string out(tailSize, '\0');
+    size_t first = std::min(tailSize, tailRing.size() - tailStart);
+    std::memcpy(out.data(), tailRing.data() + tailStart, first);
+    std::memcpy(out.data() + first, tailRing.data(), tailSize - first);
+    return out;
+  }
+  const fs::path& file() const {
+    return logFile;
+  }
+  Stats stats() const {
+    std::lock_guard<std::mutex> lock(mtx);
+    return counters;
+  }
+};
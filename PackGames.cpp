@@ -0,0 +1,94 @@
+// Packs every game under Games/ into a single .lpk file (GamePack.h) that the launcher reads in place of
+// the folder.
+//
+//   g++ -std=c++17 -O2 -pthread -finput-charset=CP932 PackGames.cpp -o pack-games
+//   ./pack-games [--games=DIR] [--out=DIR] [--no-payload] [--threads=N]
+//
+// --games is ./Games by default. The packs are written to --out (./Packs by default) at the place the
+// game folder has below --games, foo/bar/ becoming foo/bar.lpk, and replace Games/ or are copied into it
+// in place of the folders. --no-payload packs only settings.json, the icon and the detail image; such a
+// pack runs the game from the folder it was made from. A pack that is newer than everything in its
+// folder is not written again.
+#include <iostream>
+#include <string>
+#include <string_view>
+#include <optional>
+#include <vector>
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+
+#include "Logger.h"
+#include "GameScanner.h"
+#include "ThreadPool.h"
+#include "GamePack.h"
+
+std::optional<std::string_view> Option(int argc, char** argv, std::string_view name) {
+  for (int i = 1; i < argc; ++i) {
+    std::string_view arg = argv[i];
+    if (arg.substr(0, name.size()) == name)return arg.substr(name.size());
+  }
+  return std::nullopt;
+}
+
+// Whether a file in dir changed after the pack was written.
+bool Outdated(const fs::path& dir, const fs::path& pack) {
+  std::error_code ec;
+  auto packed = fs::last_write_time(pack, ec);
+  if (ec)return true;
+  if (fs::last_write_time(dir, ec) > packed || ec)return true;
+  for (fs::recursive_directory_iterator itr(dir, fs::directory_options::skip_permission_denied, ec), end;
+    !ec && itr != end; itr.increment(ec)) {
+    std::error_code fileEc;
+    if (itr->last_write_time(fileEc) > packed || fileEc)return true;
+  }
+  return static_cast<bool>(ec);
+}
+
+int main(int argc, char** argv) {
+  auto logger = std::make_shared<Logger>(std::cerr);
+  fs::path gameDir = fs::current_path() / "Games";
+  if (auto value = Option(argc, argv, "--games="))gameDir = fs::absolute(std::string(*value));
+  fs::path outDir = fs::current_path() / "Packs";
+  if (auto value = Option(argc, argv, "--out="))outDir = fs::absolute(std::string(*value));
+  bool payload = !Option(argc, argv, "--no-payload");
+  size_t threads = 0;
+  if (auto value = Option(argc, argv, "--threads="))threads = static_cast<size_t>(std::max(0, atoi(std::string(*value).c_str())));
+
+  auto start = std::chrono::steady_clock::now();
+  ScanResult scan = GameScanner().scan(gameDir);
+  std::atomic<size_t> written = 0, skipped = 0, failed = 0;
+  std::atomic<uint64_t> bytes = 0;
+  {
+    ThreadPool pool(threads);
+    for (const auto& dir : scan.gameDirs) {
+      // Games that are packs already.
+      if (GamePack::isPack(dir))continue;
+      pool.post([&, dir] {
+        fs::path out = outDir / dir.lexically_relative(gameDir);
+        out += GamePack::Extension;
+        if (!Outdated(dir, out)) {
+          ++skipped;
+          return;
+        }
+        std::string error;
+        if (!PackWriter::write(dir, out, payload, error)) {
+          logger->err("pbN쐬ł܂łF" + dir.string() + " (" + error + ")");
+          ++failed;
+          return;
+        }
+        std::error_code ec;
+        bytes += fs::file_size(out, ec);
+        ++written;
+      });
+    }
+    pool.wait();
+  }
+  logger->info(
+    "pbN쐬F" + std::to_string(written) + "쐬, " + std::to_string(skipped) + "͍쐬ς, "
+    + std::to_string(failed) + "s, " + std::to_string(bytes / (1 << 20)) + "MB, "
+    + std::to_string(std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start).count()) + "ms"
+  );
+  logger->close();
+  return failed > 0 ? EXIT_FAILURE : EXIT_SUCCESS;
+}
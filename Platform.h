@@ -0,0 +1,130 @@
+#pragma once
+#include <filesystem>
+#include <memory>
+#include <vector>
+#include <istream>
+#include <ostream>
+#include <sstream>
+#include <string>
+#include <cstdlib>
+
+namespace fs = std::filesystem;
+
+// Input codes as used by DxLib, so that DxPlatform can hand its state over unchanged.
+namespace Input {
+  constexpr int PadDown = 0x1;
+  constexpr int PadLeft = 0x2;
+  constexpr int PadRight = 0x4;
+  constexpr int PadUp = 0x8;
+  constexpr int PadX = 0x80;
+  constexpr int MouseLeft = 0x1;
+  constexpr int KeyEscape = 0x01;
+  constexpr int KeyReturn = 0x1C;
+  constexpr wchar_t CharBack = 0x08;
+  constexpr wchar_t CharTab = 0x09;
+  constexpr wchar_t CharEscape = 0x1b;
+}
+
+struct InputState {
+  char keys[256] = {};
+  int joypad = 0;
+  int mouseX = 0, mouseY = 0;
+  int mouseButtons = 0;
+  // Characters typed since the last read, including control codes (backspace, tab, escape).
+  std::wstring text;
+
+  bool anyKey() const {
+    for (char k : keys)
+      if (k)return true;
+    return false;
+  }
+  // One frame per line: "<joypad> <mouseX> <mouseY> <mouseButtons> [pressed key codes...] [t <typed characters...>]".
+  void write(std::ostream& os) const {
+    os << joypad << ' ' << mouseX << ' ' << mouseY << ' ' << mouseButtons;
+    for (int i = 0; i < 256; ++i)
+      if (keys[i])os << ' ' << i;
+    if (!text.empty()) {
+      os << " t";
+      for (wchar_t c : text)os << ' ' << static_cast<int>(c);
+    }
+    os << '\n';
+  }
+  bool read(std::istream& is) {
+    std::string line;
+    if (!std::getline(is, line))return false;
+    std::istringstream ls(line);
+    *this = InputState();
+    if (!(ls >> joypad >> mouseX >> mouseY >> mouseButtons))return false;
+    bool typed = false;
+    for (std::string token; ls >> token;) {
+      if (token == "t") {
+        typed = true;
+        continue;
+      }
+      int code = atoi(token.c_str());
+      if (typed)text += static_cast<wchar_t>(code);
+      else if (0 <= code && code < 256)keys[code] = 1;
+    }
+    return true;
+  }
+};
+
+// Decoded ARGB8 pixels kept in process memory so that textures can be recreated without touching the file again.
+struct Pixels {
+  int width = 0, height = 0;
+  std::vector<unsigned int> argb;
+};
+
+// Everything the menu needs from the machine it runs on. Graphic handles are plain ints as in DxLib; -1 is
+// "no graphic" and screen -1 is the back buffer. DxPlatform draws with DxLib, HeadlessPlatform only
+// records what would have been drawn.
+class Platform {
+public:
+  // A rectangle on the screen and the part of a texture it shows, in texture coordinates (0 to 1).
+  struct Quad {
+    float x1, y1, x2, y2;
+    float u1, v1, u2, v2;
+  };
+  // Counted by the implementations for every draw command issued.
+  size_t drawCalls = 0;
+
+  virtual ~Platform() = default;
+  virtual bool processMessages() = 0;
+  virtual void readInput(InputState& state) = 0;
+  virtual long long nowUs() = 0;
+  virtual void sleepMs(int ms) = 0;
+
+  // An image file held in memory: read into a buffer, or in place in a mapped pack.
+  virtual std::shared_ptr<const Pixels> decodeImage(const char* data, size_t size) = 0;
+  virtual std::shared_ptr<const Pixels> decodeImage(const fs::path& path) = 0;
+  virtual int createTexture(const Pixels& pixels) = 0;
+  virtual int createTexture(const unsigned int* argb, int width, int height) = 0;
+  // Movies open in the background; loadStatus() is 1 while a handle is still loading, 0 once it can be
+  // used and -1 if loading failed.
+  virtual int openMovie(const fs::path& path) = 0;
+  virtual int loadStatus(int handle) = 0;
+  virtual void playMovie(int handle, bool rewind) = 0;
+  virtual void pauseMovie(int handle) = 0;
+  virtual int makeScreen(int width, int height) = 0;
+  virtual void deleteGraph(int handle) = 0;
+  virtual void graphSize(int handle, int& width, int& height) = 0;
+  // Reads back the current contents of a graphic (e.g. the frame a movie is showing).
+  virtual std::shared_ptr<const Pixels> capture(int handle) = 0;
+
+  virtual void setDrawScreen(int handle) = 0;
+  virtual void clear() = 0;
+  // alpha = 255 draws opaque.
+  virtual void setBlend(int alpha) = 0;
+  virtual void roundRect(float x1, float y1, float x2, float y2, float rx, float ry, unsigned int color, bool fill) = 0;
+  virtual void triangle(float x1, float y1, float x2, float y2, float x3, float y3, unsigned int color, bool fill) = 0;
+  virtual void drawGraph(float x1, float y1, float x2, float y2, int handle, bool trans) = 0;
+  // Draws parts of one texture with premultiplied alpha in a single draw command.
+  virtual void drawQuads(const Quad* quads, size_t count, int handle) = 0;
+  virtual void text(float x, float y, unsigned int color, const wchar_t* str) = 0;
+  virtual int textWidth(const wchar_t* str) = 0;
+  virtual int fontSize() = 0;
+  // Renders str (lines split at '\n') into a new texture with a transparent background and returns it
+  // with its size. -1 if the text does not fit a texture; width and height are set all the same.
+  virtual int renderText(const wchar_t* str, unsigned int color, int& width, int& height) = 0;
+  virtual void present() = 0;
+};
@@ -0,0 +1,205 @@
+#pragma once
+#include <filesystem>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <vector>
+#include <algorithm>
+#include <cstdint>
+
+#include "GamePack.h"
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+namespace fs = std::filesystem;
+
+// Warms the page cache with the selected game's files once the selection has rested on it for a while.
+// The executable goes first, then the rest of the game folder largest first. Reading is paced to a
+// bandwidth cap and stops as soon as the selection moves on.
+// A packed game is warmed where it will run from: the folder a pack without payload was made from, the
+// copy already written out to the pack cache if it is current, and otherwise the pack itself, the
+// executable's range first, so that writing it out on launch reads from memory.
+class Prefetcher {
+public:
+  struct Options {
+    std::chrono::milliseconds dwell{ 800 };
+    uint64_t bytesPerSecond = 32ull << 20;
+    uint64_t maxBytes = 512ull << 20;
+    uint64_t chunk = 1ull << 20;
+  };
+  struct Report {
+    fs::path dir;
+    size_t files = 0;
+    uint64_t bytes = 0;
+    std::chrono::milliseconds elapsed{};
+    bool cancelled = false;
+  };
+private:
+  Options opt;
+  std::function<void(const Report&)> onDone;
+  std::thread worker;
+  std::mutex mtx;
+  std::condition_variable cv;
+  fs::path targetDir;
+  fs::path targetExe;
+  fs::path targetUnpacked;
+  std::chrono::steady_clock::time_point selectedAt;
+  std::atomic<uint64_t> generation = 0;
+  bool pending = false;
+  bool quit = false;
+
+  bool cancelled(uint64_t gen) const {
+    return generation.load(std::memory_order_relaxed) != gen;
+  }
+  // Reads [begin, begin + size) of one file in chunks, sleeping as needed to stay under the bandwidth cap.
+  bool warm(const fs::path& file, uint64_t size, uint64_t gen, Report& report,
+    std::chrono::steady_clock::time_point start, uint64_t begin = 0) {
+#ifdef _WIN32
+    HANDLE h = CreateFileW(file.c_str(), GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE,
+      NULL, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+    if (h == INVALID_HANDLE_VALUE)return true;
+    LARGE_INTEGER at;
+    at.QuadPart = static_cast<LONGLONG>(begin);
+    SetFilePointerEx(h, at, NULL, FILE_BEGIN);
+    std::vector<char> buf(static_cast<size_t>(opt.chunk));
+#else
+    int fd = ::open(file.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0)return true;
+    posix_fadvise(fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+#endif
+    bool ok = true;
+    for (uint64_t off = begin; off < begin + size; off += opt.chunk) {
+      if (cancelled(gen) || report.bytes >= opt.maxBytes) {
+        ok = false;
+        break;
+      }
+      uint64_t len = std::min(opt.chunk, begin + size - off);
+#ifdef _WIN32
+      DWORD read = 0;
+      if (!ReadFile(h, buf.data(), static_cast<DWORD>(len), &read, NULL) || read == 0)break;
+#else
+      if (::readahead(fd, static_cast<off_t>(off), static_cast<size_t>(len)) != 0)
+        posix_fadvise(fd, static_cast<off_t>(off), static_cast<off_t>(len), POSIX_FADV_WILLNEED);
+#endif
+      report.bytes += len;
+      auto due = start + std::chrono::microseconds(report.bytes * 1000000 / std::max<uint64_t>(opt.bytesPerSecond, 1));
+      std::unique_lock<std::mutex> lock(mtx);
+      cv.wait_until(lock, due, [&] { return quit || cancelled(gen); });
+    }
+#ifdef _WIN32
+    CloseHandle(h);
+#else
+    ::close(fd);
+#endif
+    ++report.files;
+    return ok;
+  }
+  void prefetchFolder(const fs::path& dir, const fs::path& exe, uint64_t gen, Report& report,
+    std::chrono::steady_clock::time_point start) {
+    struct File {
+      fs::path path;
+      uint64_t size;
+    };
+    std::vector<File> files;
+    std::error_code ec;
+    if (auto size = fs::file_size(exe, ec); !ec)files.push_back({ exe, size });
+    std::vector<File> rest;
+    for (fs::recursive_directory_iterator itr(dir, fs::directory_options::skip_permission_denied, ec), end;
+      !ec && itr != end && !cancelled(gen); itr.increment(ec)) {
+      if (!itr->is_regular_file(ec) || itr->path() == exe)continue;
+      if (auto size = itr->file_size(ec); !ec)rest.push_back({ itr->path(), size });
+    }
+    std::sort(rest.begin(), rest.end(), [](const File& a, const File& b) { return a.size > b.size; });
+    files.insert(files.end(), rest.begin(), rest.end());
+    for (const auto& f : files)
+      if (!warm(f.path, f.size, gen, report, start))break;
+  }
+  void prefetchPack(const fs::path& file, const fs::path& exe, const fs::path& unpacked, uint64_t gen, Report& report,
+    std::chrono::steady_clock::time_point start) {
+    GamePack pack;
+    if (!pack.open(file))return;
+    fs::path rel = exe.lexically_relative(file);
+    if (!pack.payload()) {
+      prefetchFolder(pack.source(), pack.source() / rel, gen, report, start);
+      return;
+    }
+    if (!unpacked.empty() && pack.extracted(unpacked)) {
+      prefetchFolder(unpacked, unpacked / rel, gen, report, start);
+      return;
+    }
+    uint64_t offset = 0, size = 0;
+    if (pack.locate(rel.generic_u8string(), offset, size) && !warm(file, size, gen, report, start, offset))return;
+    if (warm(file, offset, gen, report, start))warm(file, pack.bytes() - offset - size, gen, report, start, offset + size);
+  }
+  void prefetch(const fs::path& dir, const fs::path& exe, const fs::path& unpacked, uint64_t gen) {
+    auto start = std::chrono::steady_clock::now();
+    Report report;
+    report.dir = dir;
+    if (GamePack::isPack(dir))prefetchPack(dir, exe, unpacked, gen, report, start);
+    else prefetchFolder(dir, exe, gen, report, start);
+    report.cancelled = cancelled(gen);
+    report.elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start);
+    if (onDone)onDone(report);
+  }
+  void run() {
+    std::unique_lock<std::mutex> lock(mtx);
+    for (;;) {
+      cv.wait(lock, [this] { return quit || pending; });
+      if (quit)return;
+      uint64_t gen = generation;
+      // Restart the wait whenever the selection changes during the dwell time.
+      if (cv.wait_until(lock, selectedAt + opt.dwell, [&] { return quit || cancelled(gen); }))continue;
+      pending = false;
+      fs::path dir = targetDir, exe = targetExe, unpacked = targetUnpacked;
+      lock.unlock();
+      prefetch(dir, exe, unpacked, gen);
+      lock.lock();
+    }
+  }
+public:
+  Prefetcher(Options options, std::function<void(const Report&)> onDone = nullptr)
+    : opt(options), onDone(std::move(onDone)) {
+    worker = std::thread([this] { run(); });
+  }
+  Prefetcher(const Prefetcher&) = delete;
+  Prefetcher& operator=(const Prefetcher&) = delete;
+  ~Prefetcher() {
+    {
+      std::lock_guard<std::mutex> lock(mtx);
+      quit = true;
+      ++generation;
+    }
+    cv.notify_all();
+    worker.join();
+  }
+  // Called when the selection changes; any prefetch in progress for the previous game stops. unpacked is
+  // where a packed game is written out to run.
+  void select(const fs::path& dir, const fs::path& exe, const fs::path& unpacked = {}) {
+    {
+      std::lock_guard<std::mutex> lock(mtx);
+      ++generation;
+      targetDir = dir;
+      targetExe = exe;
+      targetUnpacked = unpacked;
+      selectedAt = std::chrono::steady_clock::now();
+      pending = true;
+    }
+    cv.notify_all();
+  }
+  void cancel() {
+    {
+      std::lock_guard<std::mutex> lock(mtx);
+      ++generation;
+      pending = false;
+    }
+    cv.notify_all();
+  }
+};
@@ -0,0 +1,323 @@
+#pragma once
+#include <filesystem>
+#include <string>
+#include <vector>
+#include <functional>
+#include <thread>
+#include <mutex>
+#include <atomic>
+#include <chrono>
+#include <optional>
+
+#include "OutputCapture.h"
+
+#ifdef _WIN32
+#include <windows.h>
+#include <psapi.h>
+#pragma comment(lib, "psapi.lib")
+#else
+#include <spawn.h>
+#include <signal.h>
+#include <poll.h>
+#include <unistd.h>
+#include <sys/wait.h>
+#include <sys/resource.h>
+#include <sys/syscall.h>
+extern char** environ;
+#endif
+
+namespace fs = std::filesystem;
+
+enum LaunchError_e {
+  CreateProcessError = 0,
+  CloseHandleError,
+  ChildProcessError,
+  GetExitCodeError,
+  InvalidPathError,
+  WatchdogTimeout,
+  Success
+};
+
+const std::vector<std::wstring> ErrStr = {
+  L"CreateProcessError",
+  L"CloseHandleError",
+  L"ChildProcessError",
+  L"GetExitCodeError",
+  L"InvalidPathError",
+  L"WatchdogTimeout",
+  L"Success"
+};
+
+// Runs one game at a time without blocking the caller. A waiter thread watches the child, enforces the
+// watchdog timeout and collects the resource usage; the completion callback runs on whichever thread
+// calls poll(), so the launcher can keep its render loop going while the game runs. Given a log file,
+// the game's stdout and stderr are captured into it with OutputCapture.
+class ProcessSupervisor {
+public:
+  struct Stats {
+    std::chrono::milliseconds wall{};
+    std::chrono::milliseconds cpu{};
+    size_t peakRss = 0;
+    uint64_t outputBytes = 0;
+    uint64_t droppedBytes = 0;
+  };
+  struct Result {
+    LaunchError_e error = Success;
+    int exitCode = -1;
+    Stats stats;
+    // The end of what the game wrote to stdout and stderr, if it was captured.
+    std::string output;
+  };
+  using Callback = std::function<void(const Result&)>;
+private:
+  std::thread waiter;
+  std::mutex mtx;
+  std::optional<Result> finished;
+  Callback callback;
+  std::atomic<bool> active = false;
+  std::atomic<bool> killRequested = false;
+  std::chrono::steady_clock::time_point startTime;
+  OutputCapture capture;
+  bool capturing = false;
+
+  void complete(Result r) {
+    if (capturing) {
+      // Output still in the pipes when the game exits is read, unless something it started keeps them open.
+      capture.finish(std::chrono::milliseconds(500));
+      r.output = capture.tail();
+      auto s = capture.stats();
+      r.stats.outputBytes = s.bytes;
+      r.stats.droppedBytes = s.dropped;
+      capturing = false;
+    }
+    std::lock_guard<std::mutex> lock(mtx);
+    finished = r;
+  }
+
+#ifdef _WIN32
+  static std::wstring quote(const std::wstring& arg) {
+    if (!arg.empty() && arg.find_first_of(L" \t\"") == std::wstring::npos)return arg;
+    std::wstring out = L"\"";
+    size_t slashes = 0;
+    for (wchar_t c : arg) {
+      if (c == L'\\') {
+        ++slashes;
+        continue;
+      }
+      out.append(c == L'"' ? slashes * 2 + 1 : slashes, L'\\');
+      slashes = 0;
+      out.push_back(c);
+    }
+    out.append(slashes * 2, L'\\');
+    return out + L"\"";
+  }
+  static std::chrono::milliseconds toMs(const FILETIME& t) {
+    ULONGLONG v = (static_cast<ULONGLONG>(t.dwHighDateTime) << 32) | t.dwLowDateTime;
+    return std::chrono::milliseconds(v / 10000);
+  }
+  void watch(HANDLE process, std::chrono::milliseconds timeout) {
+    Result r;
+    auto deadline = startTime + timeout;
+    for (;;) {
+      DWORD w = WaitForSingleObject(process, 100);
+      if (w == WAIT_OBJECT_0)break;
+      if (w != WAIT_TIMEOUT) {
+        r.error = ChildProcessError;
+        break;
+      }
+      bool expired = timeout.count() > 0 && std::chrono::steady_clock::now() >= deadline;
+      if (expired || killRequested) {
+        TerminateProcess(process, 1);
+        WaitForSingleObject(process, INFINITE);
+        if (expired)r.error = WatchdogTimeout;
+        break;
+      }
+    }
+    r.stats.wall = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - startTime);
+    FILETIME creation, exit, kernel, user;
+    if (GetProcessTimes(process, &creation, &exit, &kernel, &user))r.stats.cpu = toMs(kernel) + toMs(user);
+    PROCESS_MEMORY_COUNTERS mem = {};
+    if (GetProcessMemoryInfo(process, &mem, sizeof mem))r.stats.peakRss = mem.PeakWorkingSetSize;
+    DWORD code = static_cast<DWORD>(-1);
+    if (!GetExitCodeProcess(process, &code) && r.error == Success)r.error = GetExitCodeError;
+    r.exitCode = static_cast<int>(code);
+    CloseHandle(process);
+    complete(r);
+  }
+#else
+  static std::string narrow(const std::wstring& s) {
+    std::string out;
+    for (wchar_t w : s) {
+      char32_t c = static_cast<char32_t>(w);
+      if (c < 0x80)out.push_back(static_cast<char>(c));
+      else if (c < 0x800) {
+        out.push_back(static_cast<char>(0xC0 | (c >> 6)));
+        out.push_back(static_cast<char>(0x80 | (c & 0x3F)));
+      }
+      else if (c < 0x10000) {
+        out.push_back(static_cast<char>(0xE0 | (c >> 12)));
+        out.push_back(static_cast<char>(0x80 | ((c >> 6) & 0x3F)));
+        out.push_back(static_cast<char>(0x80 | (c & 0x3F)));
+      }
+      else {
+        out.push_back(static_cast<char>(0xF0 | (c >> 18)));
+        out.push_back(static_cast<char>(0x80 | ((c >> 12) & 0x3F)));
+        out.push_back(static_cast<char>(0x80 | ((c >> 6) & 0x3F)));
+        out.push_back(static_cast<char>(0x80 | (c & 0x3F)));
+      }
+    }
+    return out;
+  }
+  // Waits on a pidfd where the kernel has one, otherwise polls waitpid(WNOHANG).
+  void watch(pid_t pid, std::chrono::milliseconds timeout) {
+    Result r;
+    auto deadline = startTime + timeout;
+    int pidfd = -1;
+#ifdef SYS_pidfd_open
+    pidfd = static_cast<int>(syscall(SYS_pidfd_open, pid, 0));
+#endif
+    int status = 0;
+    struct rusage usage = {};
+    bool reaped = false;
+    for (;;) {
+      if (pidfd >= 0) {
+        struct pollfd pfd = { pidfd, POLLIN, 0 };
+        if (::poll(&pfd, 1, 100) > 0)break;
+      }
+      else {
+        pid_t w = wait4(pid, &status, WNOHANG, &usage);
+        if (w == pid) {
+          reaped = true;
+          break;
+        }
+        if (w < 0) {
+          r.error = ChildProcessError;
+          reaped = true;
+          break;
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(100));
+      }
+      bool expired = timeout.count() > 0 && std::chrono::steady_clock::now() >= deadline;
+      if (expired || killRequested) {
+        ::kill(pid, SIGKILL);
+        if (expired)r.error = WatchdogTimeout;
+        break;
+      }
+    }
+    if (!reaped && wait4(pid, &status, 0, &usage) != pid && r.error == Success)r.error = ChildProcessError;
+    if (pidfd >= 0)::close(pidfd);
+    r.stats.wall = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - startTime);
+    r.stats.cpu = std::chrono::milliseconds(
+      (usage.ru_utime.tv_sec + usage.ru_stime.tv_sec) * 1000 + (usage.ru_utime.tv_usec + usage.ru_stime.tv_usec) / 1000);
+    r.stats.peakRss = static_cast<size_t>(usage.ru_maxrss) * 1024;
+    if (WIFEXITED(status))r.exitCode = WEXITSTATUS(status);
+    else if (WIFSIGNALED(status))r.exitCode = 128 + WTERMSIG(status);
+    else if (r.error == Success)r.error = GetExitCodeError;
+    complete(r);
+  }
+#endif
+public:
+  explicit ProcessSupervisor(OutputCapture::Options output = OutputCapture::Options()) : capture(output) {}
+  ProcessSupervisor(const ProcessSupervisor&) = delete;
+  ProcessSupervisor& operator=(const ProcessSupervisor&) = delete;
+  ~ProcessSupervisor() {
+    kill();
+    if (waiter.joinable())waiter.join();
+  }
+
+  // Starts exe in workDir. A zero timeout disables the watchdog. Failures to start are reported through
+  // the callback as well, so the caller handles every outcome in one place. The game's output goes to
+  // logFile unless it is empty.
+  void start(const fs::path& exe, const std::vector<std::wstring>& args, const fs::path& workDir,
+    std::chrono::milliseconds timeout, Callback onExit, const fs::path& logFile = {}) {
+    if (waiter.joinable())waiter.join();
+    callback = std::move(onExit);
+    killRequested = false;
+    active = true;
+    startTime = std::chrono::steady_clock::now();
+    Result r;
+    if (!fs::is_regular_file(exe)) {
+      r.error = InvalidPathError;
+      complete(r);
+      return;
+    }
+    capturing = !logFile.empty() && capture.open(logFile, exe.filename().u8string());
+#ifdef _WIN32
+    // Only the arguments go on the command line, as before; games read the IP address from it directly.
+    std::wstring cmdLine;
+    for (const auto& a : args) {
+      if (!cmdLine.empty())cmdLine.push_back(L' ');
+      cmdLine += quote(a);
+    }
+    STARTUPINFOW si = {};
+    si.cb = sizeof si;
+    if (capturing) {
+      si.dwFlags = STARTF_USESTDHANDLES;
+      si.hStdOutput = capture.output(0);
+      si.hStdError = capture.output(1);
+    }
+    PROCESS_INFORMATION pi = {};
+    BOOL created = CreateProcessW(exe.c_str(), cmdLine.data(), NULL, NULL, capturing, NORMAL_PRIORITY_CLASS, NULL, workDir.c_str(), &si, &pi);
+    capture.closeOutputs();
+    if (!created) {
+      r.error = CreateProcessError;
+      complete(r);
+      return;
+    }
+    if (!CloseHandle(pi.hThread)) {
+      TerminateProcess(pi.hProcess, 1);
+      CloseHandle(pi.hProcess);
+      r.error = CloseHandleError;
+      complete(r);
+      return;
+    }
+    waiter = std::thread([this, process = pi.hProcess, timeout] { watch(process, timeout); });
+#else
+    std::vector<std::string> storage;
+    storage.push_back(exe.string());
+    for (const auto& a : args)storage.push_back(narrow(a));
+    std::vector<char*> argv;
+    for (auto& s : storage)argv.push_back(s.data());
+    argv.push_back(nullptr);
+    posix_spawn_file_actions_t actions;
+    posix_spawn_file_actions_init(&actions);
+    posix_spawn_file_actions_addchdir_np(&actions, workDir.c_str());
+    if (capturing) {
+      posix_spawn_file_actions_adddup2(&actions, capture.output(0), STDOUT_FILENO);
+      posix_spawn_file_actions_adddup2(&actions, capture.output(1), STDERR_FILENO);
+    }
+    pid_t pid;
+    int rc = posix_spawn(&pid, exe.c_str(), &actions, nullptr, argv.data(), environ);
+    posix_spawn_file_actions_destroy(&actions);
+    capture.closeOutputs();
+    if (rc != 0) {
+      r.error = CreateProcessError;
+      complete(r);
+      return;
+    }
+    waiter = std::thread([this, pid, timeout] { watch(pid, timeout); });
+#endif
+  }
+  bool running() const {
+    return active;
+  }
+  std::chrono::milliseconds elapsed() const {
+    return std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - startTime);
+  }
+  // Delivers the completion callback on the calling thread once the child has exited.
+  void poll() {
+    std::optional<Result> r;
+    {
+      std::lock_guard<std::mutex> lock(mtx);
+      r.swap(finished);
+    }
+    if (!r)return;
+    if (waiter.joinable())waiter.join();
+    active = false;
+    Callback cb = std::move(callback);
+    if (cb)cb(*r);
+  }
+  void kill() {
+    killRequested = true;
+  }
+};
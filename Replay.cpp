@@ -0,0 +1,399 @@
+// Replays an input trace through the menu on HeadlessPlatform and reports what each frame cost, so that
+// regressions in the frame loop show up on a build machine before they reach a kiosk.
+//
+//   g++ -std=c++17 -O2 -pthread -finput-charset=CP932 Replay.cpp -o replay
+//   ./replay [--games=10000] [--trace=input.txt] [--frames=N] [--seed=N] [--grid=RxC]
+//            [--immediate-render] [--texture-budget=MB] [--max-p99-us=N] [--timeline=FILE] [--atlas]
+//            [--catalog-service=NAME]
+//
+// Traces are recorded on a kiosk with --record-input=<file>. Without --trace a reproducible trace is
+// generated from --seed. --timeline writes the spans of the run in Chrome trace format. --atlas draws the
+// icons from a thumbnail atlas, as a kiosk does once its atlas is built. --catalog-service maps the
+// catalog published by a running catalog-service instead of making one up, and applies its updates
+// while replaying; several replays against one service show what each launcher costs. The exit code
+// is 1 if the 99th percentile frame time exceeds --max-p99-us.
+#include <iostream>
+#include <fstream>
+#include <vector>
+#include <string>
+#include <string_view>
+#include <optional>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <cstdio>
+#include <cstddef>
+#include <new>
+#include <sys/resource.h>
+
+#include "Logger.h"
+#include "AssetLoader.h"
+#include "HeadlessPlatform.h"
+#include "Catalog.h"
+#include "TextureCache.h"
+#include "ThumbnailAtlas.h"
+#include "SearchIndex.h"
+#include "Menu.h"
+#include "Trace.h"
+#include "CatalogService.h"
+
+namespace {
+  // Only allocations made by the replay thread between frames' start and end are counted.
+  thread_local bool countAllocations = false;
+  std::atomic<size_t> allocations = 0;
+}
+
+namespace {
+  void* allocate(size_t size, size_t align = alignof(std::max_align_t)) {
+    if (countAllocations)allocations.fetch_add(1, std::memory_order_relaxed);
+    size = size ? size : 1;
+    void* p = align <= alignof(std::max_align_t) ? std::malloc(size) : std::aligned_alloc(align, (size + align - 1) / align * align);
+    if (!p)throw std::bad_alloc();
+    return p;
+  }
+  // Not inlined, so the compiler does not pair the free() with the new expression that made the pointer.
+  [[gnu::noinline]] void release(void* p) noexcept {
+    std::free(p);
+  }
+}
+
+// Every form is replaced so that all of them are counted and all of them free what allocate() returned.
+void* operator new(size_t size) {
+  return allocate(size);
+}
+void* operator new[](size_t size) {
+  return allocate(size);
+}
+void* operator new(size_t size, std::align_val_t align) {
+  return allocate(size, static_cast<size_t>(align));
+}
+void* operator new[](size_t size, std::align_val_t align) {
+  return allocate(size, static_cast<size_t>(align));
+}
+void* operator new(size_t size, const std::nothrow_t&) noexcept {
+  try {
+    return allocate(size);
+  }
+  catch (...) {
+    return nullptr;
+  }
+}
+void* operator new[](size_t size, const std::nothrow_t&) noexcept {
+  try {
+    return allocate(size);
+  }
+  catch (...) {
+    return nullptr;
+  }
+}
+void operator delete(void* p) noexcept {
+  release(p);
+}
+void operator delete[](void* p) noexcept {
+  release(p);
+}
+void operator delete(void* p, size_t) noexcept {
+  release(p);
+}
+void operator delete[](void* p, size_t) noexcept {
+  release(p);
+}
+void operator delete(void* p, std::align_val_t) noexcept {
+  release(p);
+}
+void operator delete[](void* p, std::align_val_t) noexcept {
+  release(p);
+}
+void operator delete(void* p, size_t, std::align_val_t) noexcept {
+  release(p);
+}
+void operator delete[](void* p, size_t, std::align_val_t) noexcept {
+  release(p);
+}
+void operator delete(void* p, const std::nothrow_t&) noexcept {
+  release(p);
+}
+void operator delete[](void* p, const std::nothrow_t&) noexcept {
+  release(p);
+}
+
+std::optional<std::string_view> Option(int argc, char** argv, std::string_view name) {
+  for (int i = 1; i < argc; ++i) {
+    std::string_view arg = argv[i];
+    if (arg.substr(0, name.size()) == name)return arg.substr(name.size());
+  }
+  return std::nullopt;
+}
+
+// Mimics a visitor: holds a direction long enough to auto-repeat, sweeps the mouse over the cells, clicks
+// the page arrows and types into the search now and then. Never confirms a game.
+class SyntheticTrace {
+  uint32_t state;
+  int hold = 0;
+  int joy = 0;
+  int mouseX = 0, mouseY = 0;
+  int buttons = 0;
+  uint32_t next() {
+    state = state * 1664525u + 1013904223u;
+    return state >> 8;
+  }
+public:
+  explicit SyntheticTrace(uint32_t seed) : state(seed) {}
+  void fill(InputState& in, int width, int height) {
+    buttons = 0;
+    if (hold-- <= 0) {
+      hold = 10 + next() % 90;
+      joy = 0;
+      switch (next() % 8) {
+      case 0: joy = Input::PadRight; break;
+      case 1: joy = Input::PadLeft; break;
+      case 2: joy = Input::PadDown; break;
+      case 3: joy = Input::PadUp; break;
+      case 4:
+        mouseX = next() % width;
+        mouseY = next() % (height / 2);
+        break;
+      case 5:
+        // The right page arrow.
+        mouseX = width - width / 10 / 2;
+        mouseY = (height - height * 2 / 5 - height / 20) / 2;
+        buttons = Input::MouseLeft;
+        break;
+      case 6:
+        // Digits match the synthetic titles; a query grows a few characters before it is cleared.
+        in.text = next() % 4 ? std::wstring(1, static_cast<wchar_t>(L'0' + next() % 10)) : std::wstring(1, Input::CharEscape);
+        break;
+      default:
+        in.text = std::wstring(1, next() % 3 ? Input::CharBack : Input::CharTab);
+        break;
+      }
+    }
+    in.joypad = joy;
+    in.mouseX = mouseX;
+    in.mouseY = mouseY;
+    in.mouseButtons = buttons;
+  }
+};
+
+long MaxRssKb() {
+  rusage usage;
+  getrusage(RUSAGE_SELF, &usage);
+  return usage.ru_maxrss;
+}
+
+// Proportional set size: shared pages count divided by the processes mapping them.
+long PssKb(const char* field = "Pss:") {
+  std::ifstream ifs("/proc/self/smaps_rollup");
+  for (std::string line; std::getline(ifs, line);)
+    if (line.compare(0, strlen(field), field) == 0)return atol(line.c_str() + strlen(field));
+  return 0;
+}
+
+long long Percentile(std::vector<long long> v, double p) {
+  if (v.empty())return 0;
+  size_t n = static_cast<size_t>(p * (v.size() - 1) + 0.5);
+  std::nth_element(v.begin(), v.begin() + n, v.end());
+  return v[n];
+}
+
+int main(int argc, char** argv) {
+  const int ScreenWidth = 1920, ScreenHeight = 1080;
+  size_t gameCount = 10000;
+  if (auto value = Option(argc, argv, "--games="))gameCount = std::max(1, atoi(std::string(*value).c_str()));
+  long long maxFrames = 10000;
+  if (auto value = Option(argc, argv, "--frames="))maxFrames = atoll(std::string(*value).c_str());
+  uint32_t seed = 1;
+  if (auto value = Option(argc, argv, "--seed="))seed = static_cast<uint32_t>(atoll(std::string(*value).c_str()));
+  long long maxP99 = 0;
+  if (auto value = Option(argc, argv, "--max-p99-us="))maxP99 = atoll(std::string(*value).c_str());
+
+  std::ifstream trace;
+  if (auto value = Option(argc, argv, "--trace=")) {
+    trace.open(std::string(*value));
+    if (!trace.is_open()) {
+      std::cerr << "cannot open " << *value << '\n';
+      return 2;
+    }
+  }
+
+  std::optional<std::string_view> timeline = Option(argc, argv, "--timeline=");
+  if (timeline) {
+    Trace::enable(true);
+    Trace::nameThread("main");
+  }
+
+  auto logger = std::make_shared<Logger>(std::cerr);
+  logger->setLevel(Logger::Error);
+  HeadlessPlatform platform;
+  // All games share one icon and one detail file in a scratch folder, so that images really get read.
+  fs::path scratch = fs::temp_directory_path() / "launcher-replay";
+  fs::create_directories(scratch);
+  for (const char* name : { "icon.png", "detail.png" })std::ofstream(scratch / name, std::ios::binary) << name;
+  Catalog games;
+  std::unique_ptr<CatalogService::Client> service;
+  if (auto value = Option(argc, argv, "--catalog-service=")) {
+    service = std::make_unique<CatalogService::Client>(std::string(*value), logger);
+    if (!service->load(games, std::chrono::seconds(5))) {
+      std::cerr << "no catalog from service " << *value << '\n';
+      return 2;
+    }
+  }
+  else games.reserve(gameCount);
+  for (size_t i = 0; !service && i < gameCount; ++i) {
+    std::wstring n = std::to_wstring(i);
+    CatalogEntry e;
+    e.dir = scratch / ("game" + std::to_string(i));
+    e.title = L"Q[" + n;
+    e.version = L"1.0";
+    e.description = L"J^ÕQ[" + n;
+    e.executable = e.dir / "game.exe";
+    e.icon = scratch / "icon.png";
+    e.detail = scratch / "detail.png";
+    e.difficulty = static_cast<int>(i % 4) - 1;
+    e.is_movie = i % 6 == 1;
+    games.add(e);
+  }
+  size_t budget = 256 << 20;
+  if (auto value = Option(argc, argv, "--texture-budget="))budget = static_cast<size_t>(atoll(std::string(*value).c_str())) << 20;
+  GamePacks packs;
+  AssetLoader assets(2, &packs);
+  TextureCache textures(platform, games, assets, logger, budget);
+  textures.setPlaceholder(platform.decodeImage("", 1));
+  SearchIndex search;
+  // A launcher on a service starts on the published order and builds the index in the background; the
+  // replay builds it before the first frame anyway, since the trace searches.
+  auto presetStart = std::chrono::steady_clock::now();
+  bool preset = service && search.preset(games);
+  auto presetUs = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - presetStart).count();
+  auto buildStart = std::chrono::steady_clock::now();
+  search.build(games, {});
+  auto buildUs = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - buildStart).count();
+
+  Menu::Options options;
+  options.retained = !Option(argc, argv, "--immediate-render");
+  options.statsIntervalMs = 0;
+  if (auto value = Option(argc, argv, "--grid="))
+    if (sscanf(std::string(*value).c_str(), "%dx%d", &options.rows, &options.cols) != 2)return 2;
+  std::unique_ptr<ThumbnailAtlas> atlas;
+  if (Option(argc, argv, "--atlas")) {
+    GridLayout grid(ScreenWidth, ScreenHeight, options.rows, options.cols);
+    atlas = std::make_unique<ThumbnailAtlas>(platform, grid.iconWidth(), grid.iconHeight());
+    fs::remove(scratch / "thumbs.atlas");
+    if (!atlas->open(scratch / "thumbs.atlas")) {
+      std::cerr << "cannot open " << (scratch / "thumbs.atlas").string() << '\n';
+      return 2;
+    }
+    atlas->add(ThumbnailAtlas::key(scratch / "icon.png"), platform.decodeImage(scratch / "icon.png"));
+    atlas->wait();
+    textures.setAtlas(atlas.get());
+  }
+  Menu menu(platform, games, search, textures, logger, ScreenWidth, ScreenHeight, options);
+
+  SyntheticTrace synthetic(seed);
+  long long frame = 0;
+  platform.input = [&](InputState& in) {
+    if (frame >= maxFrames)return false;
+    if (trace.is_open())return in.read(trace);
+    synthetic.fill(in, ScreenWidth, ScreenHeight);
+    return true;
+  };
+
+  std::vector<long long> frameUs, drawCalls, allocs;
+  frameUs.reserve(maxFrames);
+  drawCalls.reserve(maxFrames);
+  allocs.reserve(maxFrames);
+  size_t launches = 0;
+  std::vector<uint32_t> changed;
+  bool everything;
+  while (platform.processMessages()) {
+    if (service && service->poll(games, changed, everything)) {
+      if (everything) {
+        search.build(games, {});
+        textures.reset();
+        changed.resize(games.size());
+        for (uint32_t i = 0; i < changed.size(); ++i)changed[i] = i;
+      }
+      else
+        for (uint32_t id : changed)search.update(games, id);
+      menu.refresh(changed);
+    }
+    size_t callsBefore = platform.drawCalls;
+    size_t allocsBefore = allocations;
+    auto start = std::chrono::steady_clock::now();
+    countAllocations = true;
+    Menu::Action action = menu.update();
+    countAllocations = false;
+    auto end = std::chrono::steady_clock::now();
+    if (!platform.processMessages())break;
+    if (action == Menu::Launch) {
+      ++launches;
+      menu.suspend();
+      textures.release();
+      textures.restore();
+      menu.resume();
+    }
+    platform.present();
+    frameUs.push_back(std::chrono::duration_cast<std::chrono::microseconds>(end - start).count());
+    drawCalls.push_back(static_cast<long long>(platform.drawCalls - callsBefore));
+    allocs.push_back(static_cast<long long>(allocations - allocsBefore));
+    ++frame;
+  }
+  logger->close();
+  if (timeline && !Trace::flush(std::string(*timeline))) {
+    std::cerr << "cannot write " << *timeline << '\n';
+    return 2;
+  }
+
+  // Type-ahead as a visitor would do it: every prefix of a few queries, in each order.
+  std::vector<long long> searchUs;
+  std::vector<uint32_t> results;
+  for (std::wstring_view q : { L"Q[1", L"123", L"9999", L"J^O", L"ް", L"1.0", L"x" }) {
+    for (int order = 0; order < SearchIndex::OrderCount; ++order) {
+      for (size_t n = 1; n <= q.size(); ++n) {
+        auto start = std::chrono::steady_clock::now();
+        search.query(q.substr(0, n), static_cast<SearchIndex::Order>(order), results);
+        searchUs.push_back(std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start).count());
+      }
+    }
+  }
+
+  auto avg = [](const std::vector<long long>& v) {
+    long long sum = 0;
+    for (long long x : v)sum += x;
+    return v.empty() ? 0.0 : static_cast<double>(sum) / v.size();
+  };
+  auto max = [](const std::vector<long long>& v) {
+    return v.empty() ? 0 : *std::max_element(v.begin(), v.end());
+  };
+  long long p99 = Percentile(frameUs, 0.99);
+  std::cout
+    << "games          " << games.size() << '\n'
+    << "frames         " << frameUs.size() << (options.retained ? " (retained)" : " (immediate)") << '\n'
+    << "frame time us  p50 " << Percentile(frameUs, 0.5) << "  p90 " << Percentile(frameUs, 0.9)
+    << "  p99 " << p99 << "  max " << max(frameUs) << '\n'
+    << "draw calls     avg " << avg(drawCalls) << "  max " << max(drawCalls) << '\n'
+    << "allocations    avg " << avg(allocs) << "  max " << max(allocs) << '\n'
+    << "textures       " << platform.counters.texturesCreated << " created, " << platform.liveGraphs() << " live\n"
+    << "text           " << platform.counters.textsRendered << " rendered\n"
+    << "launches       " << launches << '\n'
+    << "movies         " << menu.movies().stats().opens << " opened, at most " << menu.movies().stats().maxOpen << " open\n"
+    << "memory         catalog " << games.bytes() / 1024 << "KB  textures " << textures.stats().residentBytes / 1024 << "KB/"
+    << budget / 1024 << "KB (" << textures.stats().resident << " resident, " << textures.stats().loads << " loads, "
+    << textures.stats().evictions << " evictions)  max rss " << MaxRssKb() << "KB\n"
+    << (service
+      ? "service        generation " + std::to_string(service->stats().generation) + "  attach " + std::to_string(service->stats().attachUs)
+        + "us  preset " + (preset ? std::to_string(presetUs) + "us" : std::string("-")) + "  updates " + std::to_string(service->stats().updates) + "  pss " + std::to_string(PssKb()) + "KB (shared memory "
+        + std::to_string(PssKb("Pss_Shmem:")) + "KB)\n"
+      : "")
+    << "search us      build " << buildUs << "  query p50 " << Percentile(searchUs, 0.5) << "  p99 " << Percentile(searchUs, 0.99)
+    << "  max " << max(searchUs) << " (" << search.grams() << " grams)\n"
+    << "input latency  " << menu.inputLatency().count() << " changes, p50 <" << menu.inputLatency().percentile(0.5)
+    << "us  p99 <" << menu.inputLatency().percentile(0.99) << "us  max " << menu.inputLatency().max() << "us\n"
+    << "               " << menu.inputLatency().str() << '\n';
+  if (maxP99 > 0 && p99 > maxP99) {
+    std::cout << "p99 " << p99 << "us exceeds " << maxP99 << "us\n";
+    return 1;
+  }
+  return 0;
+}
@@ -0,0 +1,239 @@
+#pragma once
+#include <vector>
+#include <array>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <algorithm>
+#include <climits>
+#include <cstdint>
+
+#include "Catalog.h"
+
+// In-memory index over title, version and description for type-ahead search, together with the catalog
+// in each sort order. Text is matched as a normalized substring; the candidates come from a posting list
+// of character pairs so that a query only looks at entries that can contain it.
+class SearchIndex {
+public:
+  enum Order {
+    ByDifficulty,
+    ByTitle,
+    // The folders listed in order.txt first, the rest by difficulty.
+    ByCustom,
+    // Most played first (SessionJournal), the rest by difficulty.
+    ByPlays,
+    OrderCount
+  };
+private:
+  // Normalized "title\nversion\ndescription" of every game, empty for removed games.
+  std::vector<std::wstring> text;
+  // Character pair (or single character, paired with 0) -> ascending ids of the games containing it.
+  std::unordered_map<uint64_t, std::vector<uint32_t>> postings;
+  std::array<std::vector<uint32_t>, OrderCount> orders;
+  static inline const std::vector<uint32_t> none;
+  // Sort keys. Unknown difficulty (-1) is INT_MAX so that it sorts last; games not in order.txt rank SIZE_MAX.
+  std::vector<std::wstring> titles;
+  std::vector<int> difficulty;
+  std::vector<size_t> rank;
+  std::vector<uint32_t> plays;
+  std::unordered_map<std::wstring, size_t> listed;
+
+  std::wstring lastQuery;
+  bool hasLast = false;
+  std::vector<uint32_t> lastMatches;
+  std::vector<uint32_t> scratch;
+  std::vector<uint8_t> mark;
+
+  static uint64_t gram(wchar_t a, wchar_t b) {
+    return static_cast<uint64_t>(static_cast<uint32_t>(a)) << 32 | static_cast<uint32_t>(b);
+  }
+  void post(uint64_t key, uint32_t id) {
+    auto& list = postings[key];
+    if (list.empty() || list.back() < id)list.push_back(id);
+    else {
+      auto itr = std::lower_bound(list.begin(), list.end(), id);
+      if (*itr != id)list.insert(itr, id);
+    }
+  }
+  void unpost(uint64_t key, uint32_t id) {
+    auto found = postings.find(key);
+    if (found == postings.end())return;
+    auto& list = found->second;
+    auto itr = std::lower_bound(list.begin(), list.end(), id);
+    if (itr != list.end() && *itr == id)list.erase(itr);
+    if (list.empty())postings.erase(found);
+  }
+  // Each order is by its own key, then by difficulty, then by index, i.e. catalog order among equals.
+  bool before(int order, uint32_t a, uint32_t b) const {
+    if (order == ByTitle && titles[a] != titles[b])return titles[a] < titles[b];
+    if (order == ByCustom && rank[a] != rank[b])return rank[a] < rank[b];
+    if (order == ByPlays && plays[a] != plays[b])return plays[a] > plays[b];
+    if (difficulty[a] != difficulty[b])return difficulty[a] < difficulty[b];
+    return a < b;
+  }
+  void describe(const Catalog& games, uint32_t id) {
+    text[id] = normalize(games.title(id)) + L'\n' + normalize(games.version(id)) + L'\n' + normalize(games.description(id));
+    const std::wstring& t = text[id];
+    for (size_t i = 0; i < t.size(); ++i) {
+      post(gram(t[i], 0), id);
+      if (i + 1 < t.size())post(gram(t[i], t[i + 1]), id);
+    }
+    titles[id] = t.substr(0, t.find(L'\n'));
+    difficulty[id] = games.difficulty(id) < 0 ? INT_MAX : games.difficulty(id);
+    auto itr = listed.find(games.dir(id).filename().wstring());
+    rank[id] = itr != listed.end() ? itr->second : SIZE_MAX;
+  }
+  void forget(uint32_t id) {
+    for (int order = 0; order < OrderCount; ++order) {
+      auto& o = orders[order];
+      auto itr = std::lower_bound(o.begin(), o.end(), id, [&](uint32_t a, uint32_t b) { return before(order, a, b); });
+      if (itr != o.end() && *itr == id)o.erase(itr);
+    }
+    const std::wstring& t = text[id];
+    for (size_t i = 0; i < t.size(); ++i) {
+      unpost(gram(t[i], 0), id);
+      if (i + 1 < t.size())unpost(gram(t[i], t[i + 1]), id);
+    }
+    text[id].clear();
+  }
+  void insert(const Catalog& games, uint32_t id) {
+    describe(games, id);
+    for (int order = 0; order < OrderCount; ++order) {
+      auto& o = orders[order];
+      o.insert(std::lower_bound(o.begin(), o.end(), id, [&](uint32_t a, uint32_t b) { return before(order, a, b); }), id);
+    }
+  }
+  void resize(size_t n) {
+    text.resize(n);
+    titles.resize(n);
+    difficulty.resize(n, INT_MAX);
+    rank.resize(n, SIZE_MAX);
+    plays.resize(n, 0);
+    mark.resize(n, 0);
+  }
+  static wchar_t fold(wchar_t c) {
+    if (c == 0x3000 || c == L'\t' || c == L'\r' || c == L'\n')return L' ';
+    if (0xff01 <= c && c <= 0xff5e)c = static_cast<wchar_t>(c - 0xff01 + 0x21);
+    if (L'A' <= c && c <= L'Z')return static_cast<wchar_t>(c - L'A' + L'a');
+    if (0x30a1 <= c && c <= 0x30f6)return static_cast<wchar_t>(c - 0x60);
+    return c;
+  }
+public:
+  // Full-width ASCII to half-width, upper to lower case, katakana to hiragana and runs of white space to
+  // one space, so that "`ab" finds "abc" and "ς" finds "pY".
+  static std::wstring normalize(std::wstring_view s) {
+    std::wstring out;
+    out.reserve(s.size());
+    for (wchar_t c : s) {
+      c = fold(c);
+      if (c == L' ' && (out.empty() || out.back() == L' '))continue;
+      out += c;
+    }
+    if (!out.empty() && out.back() == L' ')out.pop_back();
+    return out;
+  }
+
+  // customOrder lists game folder names (the last path component) in the order ByCustom shows them;
+  // playCounts holds the number of plays by game index for ByPlays.
+  void build(const Catalog& games, const std::vector<std::wstring>& customOrder, const std::vector<uint32_t>& playCounts = {}) {
+    listed.clear();
+    for (size_t i = 0; i < customOrder.size(); ++i)listed.emplace(customOrder[i], i);
+    uint32_t n = static_cast<uint32_t>(games.size());
+    text.clear();
+    titles.clear();
+    difficulty.clear();
+    rank.clear();
+    plays.assign(playCounts.begin(), playCounts.begin() + std::min<size_t>(playCounts.size(), n));
+    mark.clear();
+    resize(n);
+    postings.clear();
+    for (auto& o : orders)o.clear();
+    for (uint32_t id = 0; id < n; ++id) {
+      if (games.removed(id))continue;
+      describe(games, id);
+      for (auto& o : orders)o.push_back(id);
+    }
+    for (int order = 0; order < OrderCount; ++order)
+      std::sort(orders[order].begin(), orders[order].end(), [&](uint32_t a, uint32_t b) { return before(order, a, b); });
+    hasLast = false;
+  }
+  // Shows the difficulty order published with an attached catalog (Catalog::publishedOrder) in every
+  // order, without looking at the games, until build() runs; queries match nothing until then. False if
+  // the catalog has no published order.
+  bool preset(const Catalog& games) {
+    const uint32_t* order = games.publishedOrder();
+    if (!order)return false;
+    text.clear();
+    postings.clear();
+    mark.assign(games.size(), 0);
+    for (auto& o : orders)o.assign(order, order + games.live());
+    hasLast = false;
+    return true;
+  }
+  // Brings one game up to date after it was added to, changed in or removed from the catalog. Costs about
+  // as much as the game's text plus moving the ids behind it in each order.
+  void update(const Catalog& games, uint32_t id) {
+    if (id >= text.size())resize(games.size());
+    else if (!text[id].empty())forget(id);
+    if (!games.removed(id))insert(games, id);
+    hasLast = false;
+  }
+  // A game was played again.
+  void setPlays(const Catalog& games, uint32_t id, uint32_t n) {
+    if (id >= text.size())resize(games.size());
+    else if (!text[id].empty())forget(id);
+    plays[id] = n;
+    if (!games.removed(id))insert(games, id);
+    hasLast = false;
+  }
+
+  size_t size() const {
+    return orders[ByDifficulty].size();
+  }
+  size_t grams() const {
+    return postings.size();
+  }
+
+  // Ids of the games matching the query, in the given order; an empty query matches everything. A query
+  // that extends the previous one only narrows the previous matches, so typing one more character costs
+  // no more than the matches so far.
+  void query(std::wstring_view q, Order order, std::vector<uint32_t>& out) {
+    std::wstring nq = normalize(q);
+    out.clear();
+    if (nq.empty()) {
+      hasLast = false;
+      out = orders[order];
+      return;
+    }
+    const std::vector<uint32_t>* candidates = &lastMatches;
+    if (!hasLast || nq.compare(0, lastQuery.size(), lastQuery) != 0) {
+      if (nq.size() == 1) {
+        auto itr = postings.find(gram(nq[0], 0));
+        candidates = itr != postings.end() ? &itr->second : &none;
+      }
+      else {
+        candidates = nullptr;
+        for (size_t i = 0; i + 1 < nq.size(); ++i) {
+          auto itr = postings.find(gram(nq[i], nq[i + 1]));
+          if (itr == postings.end()) {
+            candidates = &none;
+            break;
+          }
+          if (!candidates || itr->second.size() < candidates->size())candidates = &itr->second;
+        }
+      }
+    }
+    scratch.clear();
+    for (uint32_t id : *candidates)
+      if (text[id].find(nq) != std::wstring::npos)scratch.push_back(id);
+    lastMatches.swap(scratch);
+    lastQuery = std::move(nq);
+    hasLast = true;
+
+    for (uint32_t id : lastMatches)mark[id] = 1;
+    out.reserve(lastMatches.size());
+    for (uint32_t id : orders[order])
+      if (mark[id])out.push_back(id);
+    for (uint32_t id : lastMatches)mark[id] = 0;
+  }
+};
@@ -0,0 +1,206 @@
+#pragma once
+#include <filesystem>
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+namespace fs = std::filesystem;
+
+// Record of every game played, in a memory-mapped file of fixed size: a table of per-game totals sorted
+// by game key, followed by the sessions not yet folded into it. Appending a session writes one record
+// and bumps a counter. The sessions are folded into the totals when the file is opened and whenever the
+// journal fills up, so reading the totals needs nothing but mapping the file.
+// Games are keyed by a hash of their folder relative to Games/, which survives catalog rebuilds and a
+// moved launcher folder.
+class SessionJournal {
+public:
+  static constexpr uint32_t MaxGames = 8192;
+  static constexpr uint32_t MaxSessions = 4096;
+  struct Session {
+    uint64_t game;
+    // Unix time in milliseconds.
+    int64_t startMs;
+    uint32_t durationMs;
+    int32_t exitCode;
+    int32_t error;
+    uint32_t failed;
+  };
+  struct Aggregate {
+    uint64_t game;
+    uint32_t plays;
+    uint32_t failures;
+    uint64_t totalMs;
+    int64_t lastMs;
+  };
+private:
+  static constexpr char Magic[4] = { 'L', 'S', 'J', 'N' };
+  static constexpr uint32_t Version = 1;
+  struct Header {
+    char magic[4];
+    uint32_t version;
+    uint32_t maxGames;
+    uint32_t maxSessions;
+    uint32_t games;
+    uint32_t sessions;
+    // Sessions already folded into the totals, so that a compaction cut short is not counted twice.
+    uint32_t applied;
+    uint32_t dropped;
+  };
+  static_assert(sizeof(Session) == 32 && sizeof(Aggregate) == 32 && sizeof(Header) == 32, "file layout");
+  static constexpr size_t FileSize = sizeof(Header) + sizeof(Aggregate) * MaxGames + sizeof(Session) * MaxSessions;
+
+#ifdef _WIN32
+  HANDLE file = INVALID_HANDLE_VALUE;
+  HANDLE mapping = NULL;
+#else
+  int fd = -1;
+#endif
+  void* view = nullptr;
+  Header* header = nullptr;
+  Aggregate* aggregates = nullptr;
+  Session* sessions = nullptr;
+
+  void fold(const Session& s) {
+    Aggregate* end = aggregates + header->games;
+    Aggregate* a = std::lower_bound(aggregates, end, s.game, [](const Aggregate& x, uint64_t g) { return x.game < g; });
+    if (a == end || a->game != s.game) {
+      if (header->games >= MaxGames) {
+        ++header->dropped;
+        return;
+      }
+      std::memmove(a + 1, a, (end - a) * sizeof(Aggregate));
+      *a = Aggregate{ s.game, 0, 0, 0, 0 };
+      ++header->games;
+    }
+    ++a->plays;
+    if (s.failed)++a->failures;
+    a->totalMs += s.durationMs;
+    a->lastMs = std::max(a->lastMs, s.startMs + static_cast<int64_t>(s.durationMs));
+  }
+public:
+  SessionJournal() = default;
+  SessionJournal(const SessionJournal&) = delete;
+  SessionJournal& operator=(const SessionJournal&) = delete;
+  ~SessionJournal() {
+    close();
+  }
+
+  static uint64_t key(const fs::path& gameDir, const fs::path& root) {
+    std::wstring rel = gameDir.lexically_relative(root).generic_wstring();
+    uint64_t h = 1469598103934665603ull;
+    for (wchar_t c : rel) {
+      h ^= static_cast<uint16_t>(c);
+      h *= 1099511628211ull;
+    }
+    return h;
+  }
+
+  // Maps the file, creating it if needed, and folds the sessions left from the last run. A file of another
+  // version or size starts over.
+  bool open(const fs::path& path) {
+    close();
+#ifdef _WIN32
+    file = CreateFileW(path.c_str(), GENERIC_READ | GENERIC_WRITE, FILE_SHARE_READ, NULL, OPEN_ALWAYS, FILE_ATTRIBUTE_NORMAL, NULL);
+    if (file == INVALID_HANDLE_VALUE)return false;
+    // Mapping more than the file holds extends it with zeros.
+    mapping = CreateFileMappingW(file, NULL, PAGE_READWRITE, 0, static_cast<DWORD>(FileSize), NULL);
+    if (mapping != NULL)view = MapViewOfFile(mapping, FILE_MAP_ALL_ACCESS, 0, 0, FileSize);
+#else
+    fd = ::open(path.c_str(), O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+    if (fd < 0)return false;
+    struct stat st;
+    if (fstat(fd, &st) != 0 || (static_cast<size_t>(st.st_size) != FileSize && ftruncate(fd, FileSize) != 0)) {
+      close();
+      return false;
+    }
+    view = mmap(nullptr, FileSize, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if (view == MAP_FAILED)view = nullptr;
+#endif
+    if (!view) {
+      close();
+      return false;
+    }
+    header = static_cast<Header*>(view);
+    aggregates = reinterpret_cast<Aggregate*>(header + 1);
+    sessions = reinterpret_cast<Session*>(aggregates + MaxGames);
+    if (std::memcmp(header->magic, Magic, sizeof(Magic)) != 0 || header->version != Version || header->maxGames != MaxGames
+      || header->maxSessions != MaxSessions || header->games > MaxGames || header->sessions > MaxSessions || header->applied > header->sessions) {
+      std::memset(view, 0, sizeof(Header));
+      std::memcpy(header->magic, Magic, sizeof(Magic));
+      header->version = Version;
+      header->maxGames = MaxGames;
+      header->maxSessions = MaxSessions;
+    }
+    compact();
+    return true;
+  }
+  void close() {
+#ifdef _WIN32
+    if (view) {
+      FlushViewOfFile(view, 0);
+      UnmapViewOfFile(view);
+    }
+    if (mapping != NULL)CloseHandle(mapping);
+    if (file != INVALID_HANDLE_VALUE)CloseHandle(file);
+    file = INVALID_HANDLE_VALUE;
+    mapping = NULL;
+#else
+    if (view)munmap(view, FileSize);
+    if (fd >= 0)::close(fd);
+    fd = -1;
+#endif
+    view = nullptr;
+    header = nullptr;
+  }
+  bool isOpen() const {
+    return header != nullptr;
+  }
+
+  // One record and a counter; the data reaches the disk with the OS's write-back of the mapping.
+  void append(const Session& s) {
+    if (!header)return;
+    if (header->sessions == MaxSessions)compact();
+    sessions[header->sessions] = s;
+    ++header->sessions;
+  }
+  void compact() {
+    if (!header)return;
+    for (; header->applied < header->sessions; ++header->applied)fold(sessions[header->applied]);
+    header->sessions = 0;
+    header->applied = 0;
+  }
+
+  // The totals of a game, including the sessions appended since the last compaction. plays is 0 for a
+  // game never played.
+  Aggregate totals(uint64_t game) const {
+    Aggregate total{ game, 0, 0, 0, 0 };
+    if (!header)return total;
+    const Aggregate* end = aggregates + header->games;
+    const Aggregate* a = std::lower_bound(static_cast<const Aggregate*>(aggregates), end, game, [](const Aggregate& x, uint64_t g) { return x.game < g; });
+    if (a != end && a->game == game)total = *a;
+    for (uint32_t i = 0; i < header->sessions; ++i) {
+      const Session& s = sessions[i];
+      if (s.game != game)continue;
+      ++total.plays;
+      if (s.failed)++total.failures;
+      total.totalMs += s.durationMs;
+      total.lastMs = std::max(total.lastMs, s.startMs + static_cast<int64_t>(s.durationMs));
+    }
+    return total;
+  }
+  size_t games() const {
+    return header ? header->games : 0;
+  }
+  size_t pending() const {
+    return header ? header->sessions : 0;
+  }
+};
@@ -0,0 +1,363 @@
+#pragma once
+#include <filesystem>
+#include <fstream>
+#include <string>
+#include <string_view>
+#include <charconv>
+#include <cstring>
+
+#include "CatalogIndex.h"
+
+namespace fs = std::filesystem;
+
+struct SettingsError {
+  int line = 0;
+  int column = 0;
+  std::string message;
+  std::string str() const {
+    return std::to_string(line) + ":" + std::to_string(column) + ": " + message;
+  }
+};
+
+// Single-pass parser for settings.json. Reads UTF-8 straight into the CatalogEntry fields and validates the
+// schema on the way; keys are compared in place, so nothing is allocated per key.
+//
+// {
+//   "title": string, "version": string|number, "description": string,
+//   "executable": string, "icon": string,
+//   "detail": { "file": string, "is_movie": bool },
+//   "difficulty": integer in [-1, 2]
+// }
+//
+// Unknown keys are skipped.
+class SettingsParser {
+private:
+  static constexpr int MaxDepth = 64;
+  static constexpr int MinDifficulty = -1;
+  static constexpr int MaxDifficulty = 2;
+
+  const char* begin;
+  const char* p;
+  const char* end;
+  const fs::path& dir;
+  CatalogEntry& entry;
+  SettingsError& error;
+
+  bool fail(const char* at, std::string message) {
+    error.line = 1;
+    error.column = 1;
+    for (const char* c = begin; c < at && c < end; ++c) {
+      if (*c == '\n') {
+        ++error.line;
+        error.column = 1;
+      }
+      else if ((static_cast<unsigned char>(*c) & 0xC0) != 0x80)++error.column;
+    }
+    error.message = std::move(message);
+    return false;
+  }
+  void ws() {
+    while (p < end && (*p == ' ' || *p == '\t' || *p == '\n' || *p == '\r'))++p;
+  }
+  bool expect(char c) {
+    ws();
+    if (p >= end || *p != c)return fail(p, std::string("expected '") + c + "'");
+    ++p;
+    return true;
+  }
+  static void append(std::wstring& out, char32_t cp) {
+    if constexpr (sizeof(wchar_t) == 2) {
+      if (cp >= 0x10000) {
+        cp -= 0x10000;
+        out.push_back(static_cast<wchar_t>(0xD800 + (cp >> 10)));
+        out.push_back(static_cast<wchar_t>(0xDC00 + (cp & 0x3FF)));
+        return;
+      }
+    }
+    out.push_back(static_cast<wchar_t>(cp));
+  }
+  bool hex4(unsigned& v) {
+    v = 0;
+    if (end - p < 4)return fail(p, "truncated \\u escape");
+    for (int i = 0; i < 4; ++i, ++p) {
+      char c = *p;
+      v <<= 4;
+      if ('0' <= c && c <= '9')v |= c - '0';
+      else if ('a' <= c && c <= 'f')v |= c - 'a' + 10;
+      else if ('A' <= c && c <= 'F')v |= c - 'A' + 10;
+      else return fail(p, "invalid \\u escape");
+    }
+    return true;
+  }
+  // Decodes a string into out, or just validates it when out is null.
+  bool string(std::wstring* out) {
+    ws();
+    if (p >= end || *p != '"')return fail(p, "expected string");
+    const char* start = p++;
+    if (out)out->clear();
+    while (p < end) {
+      unsigned char c = static_cast<unsigned char>(*p);
+      if (c == '"') {
+        ++p;
+        return true;
+      }
+      if (c < 0x20)return fail(p, "control character in string");
+      if (c == '\\') {
+        if (++p >= end)break;
+        char32_t cp;
+        switch (*p++) {
+        case '"': cp = '"'; break;
+        case '\\': cp = '\\'; break;
+        case '/': cp = '/'; break;
+        case 'b': cp = '\b'; break;
+        case 'f': cp = '\f'; break;
+        case 'n': cp = '\n'; break;
+        case 'r': cp = '\r'; break;
+        case 't': cp = '\t'; break;
+        case 'u': {
+          unsigned hi;
+          if (!hex4(hi))return false;
+          cp = hi;
+          if (0xD800 <= hi && hi < 0xDC00) {
+            unsigned lo;
+            if (end - p < 2 || p[0] != '\\' || p[1] != 'u')return fail(p, "unpaired surrogate");
+            p += 2;
+            if (!hex4(lo))return false;
+            if (lo < 0xDC00 || 0xE000 <= lo)return fail(p, "unpaired surrogate");
+            cp = 0x10000 + ((hi - 0xD800) << 10) + (lo - 0xDC00);
+          }
+          break;
+        }
+        default:
+          return fail(p - 1, "invalid escape");
+        }
+        if (out)append(*out, cp);
+        continue;
+      }
+      if (c < 0x80) {
+        if (out)out->push_back(static_cast<wchar_t>(c));
+        ++p;
+        continue;
+      }
+      int len = c >= 0xF0 ? 4 : c >= 0xE0 ? 3 : c >= 0xC0 ? 2 : 0;
+      if (len == 0 || c > 0xF4 || end - p < len)return fail(p, "invalid UTF-8");
+      char32_t cp = c & (0x3F >> (len - 1));
+      for (int i = 1; i < len; ++i) {
+        unsigned char cc = static_cast<unsigned char>(p[i]);
+        if ((cc & 0xC0) != 0x80)return fail(p, "invalid UTF-8");
+        cp = (cp << 6) | (cc & 0x3F);
+      }
+      static const char32_t minimum[] = { 0, 0, 0x80, 0x800, 0x10000 };
+      if (cp < minimum[len] || cp > 0x10FFFF || (0xD800 <= cp && cp < 0xE000))return fail(p, "invalid UTF-8");
+      if (out)append(*out, cp);
+      p += len;
+    }
+    return fail(start, "unterminated string");
+  }
+  // Object keys are matched against short ASCII names, so they are unescaped into a fixed buffer.
+  bool key(char (&buf)[32], size_t& len) {
+    ws();
+    if (p >= end || *p != '"')return fail(p, "expected key");
+    const char* start = p++;
+    len = 0;
+    while (p < end && *p != '"') {
+      char c = *p++;
+      if (c == '\\') {
+        if (p >= end)break;
+        c = *p++;
+        if (c == 'u') {
+          unsigned v = 0;
+          if (!hex4(v))return false;
+          c = v < 0x80 ? static_cast<char>(v) : '\x7f';
+        }
+      }
+      if (len < sizeof buf)buf[len] = c;
+      ++len;
+    }
+    if (p >= end)return fail(start, "unterminated string");
+    ++p;
+    if (len > sizeof buf)len = sizeof buf;
+    return expect(':');
+  }
+  bool number(std::string_view& text) {
+    ws();
+    const char* start = p;
+    if (p < end && *p == '-')++p;
+    if (p < end && *p == '0')++p;
+    else if (p < end && '1' <= *p && *p <= '9')while (p < end && '0' <= *p && *p <= '9')++p;
+    else return fail(start, "expected number");
+    if (p < end && *p == '.') {
+      if (++p >= end || *p < '0' || '9' < *p)return fail(p, "invalid number");
+      while (p < end && '0' <= *p && *p <= '9')++p;
+    }
+    if (p < end && (*p == 'e' || *p == 'E')) {
+      ++p;
+      if (p < end && (*p == '+' || *p == '-'))++p;
+      if (p >= end || *p < '0' || '9' < *p)return fail(p, "invalid number");
+      while (p < end && '0' <= *p && *p <= '9')++p;
+    }
+    text = std::string_view(start, p - start);
+    return true;
+  }
+  bool literal(std::string_view word) {
+    if (static_cast<size_t>(end - p) < word.size() || std::memcmp(p, word.data(), word.size()) != 0)
+      return fail(p, "invalid literal");
+    p += word.size();
+    return true;
+  }
+  bool boolean(bool& v, const char* name) {
+    ws();
+    if (p < end && *p == 't') {
+      v = true;
+      return literal("true");
+    }
+    if (p < end && *p == 'f') {
+      v = false;
+      return literal("false");
+    }
+    return fail(p, std::string("\"") + name + "\" must be a boolean");
+  }
+  bool skip(int depth) {
+    if (depth > MaxDepth)return fail(p, "nesting too deep");
+    ws();
+    if (p >= end)return fail(p, "unexpected end of file");
+    switch (*p) {
+    case '"':
+      return string(nullptr);
+    case '{':
+      return object([this, depth](std::string_view) { return skip(depth + 1); });
+    case '[': {
+      ++p;
+      ws();
+      if (p < end && *p == ']') {
+        ++p;
+        return true;
+      }
+      for (;;) {
+        if (!skip(depth + 1))return false;
+        ws();
+        if (p < end && *p == ',') {
+          ++p;
+          continue;
+        }
+        return expect(']');
+      }
+    }
+    case 't':
+      return literal("true");
+    case 'f':
+      return literal("false");
+    case 'n':
+      return literal("null");
+    default: {
+      std::string_view text;
+      return number(text);
+    }
+    }
+  }
+  // Nesting is limited by skip(), which every member that is not read goes through.
+  template<class F> bool object(F&& member) {
+    if (!expect('{'))return false;
+    ws();
+    if (p < end && *p == '}') {
+      ++p;
+      return true;
+    }
+    for (;;) {
+      char buf[32];
+      size_t len;
+      if (!key(buf, len) || !member(std::string_view(buf, len)))return false;
+      ws();
+      if (p < end && *p == ',') {
+        ++p;
+        continue;
+      }
+      return expect('}');
+    }
+  }
+  bool path(fs::path& out, const char* name) {
+    ws();
+    if (p >= end || *p != '"')return fail(p, std::string("\"") + name + "\" must be a string");
+    thread_local std::wstring value;
+    if (!string(&value))return false;
+    out = dir / value;
+    return true;
+  }
+  bool text(std::wstring& out, const char* name, bool allowNumber = false) {
+    ws();
+    if (allowNumber && p < end && (*p == '-' || ('0' <= *p && *p <= '9'))) {
+      std::string_view digits;
+      if (!number(digits))return false;
+      out.assign(digits.begin(), digits.end());
+      return true;
+    }
+    if (p >= end || *p != '"')return fail(p, std::string("\"") + name + "\" must be a string");
+    return string(&out);
+  }
+  bool difficulty() {
+    ws();
+    const char* at = p;
+    std::string_view digits;
+    if (p >= end || (*p != '-' && (*p < '0' || '9' < *p)))return fail(p, "\"difficulty\" must be an integer");
+    if (!number(digits))return false;
+    int v = 0;
+    auto r = std::from_chars(digits.data(), digits.data() + digits.size(), v);
+    if (r.ec != std::errc() || r.ptr != digits.data() + digits.size())return fail(at, "\"difficulty\" must be an integer");
+    if (v < MinDifficulty || MaxDifficulty < v)
+      return fail(at, "\"difficulty\" must be between " + std::to_string(MinDifficulty) + " and " + std::to_string(MaxDifficulty));
+    entry.difficulty = v;
+    return true;
+  }
+  bool detail(int depth) {
+    ws();
+    if (p >= end || *p != '{')return fail(p, "\"detail\" must be an object");
+    return object([this, depth](std::string_view k) {
+      if (k == "file")return path(entry.detail, "detail.file");
+      if (k == "is_movie")return boolean(entry.is_movie, "detail.is_movie");
+      return skip(depth + 1);
+    });
+  }
+  bool document() {
+    if (end - p >= 3 && std::memcmp(p, "\xEF\xBB\xBF", 3) == 0)p += 3;
+    ws();
+    if (p >= end || *p != '{')return fail(p, "settings.json must contain an object");
+    bool ok = object([this](std::string_view k) {
+      if (k == "title")return text(entry.title, "title");
+      if (k == "version")return text(entry.version, "version", true);
+      if (k == "description")return text(entry.description, "description");
+      if (k == "executable")return path(entry.executable, "executable");
+      if (k == "icon")return path(entry.icon, "icon");
+      if (k == "detail")return detail(1);
+      if (k == "difficulty")return difficulty();
+      return skip(1);
+    });
+    if (!ok)return false;
+    ws();
+    if (p != end)return fail(p, "trailing characters after object");
+    return true;
+  }
+
+  SettingsParser(const char* data, size_t size, const fs::path& dir, CatalogEntry& entry, SettingsError& error)
+    : begin(data), p(data), end(data + size), dir(dir), entry(entry), error(error) {}
+public:
+  // Fields absent from the file keep whatever entry already holds, so callers fill in the defaults first.
+  static bool parse(const char* data, size_t size, const fs::path& dir, CatalogEntry& entry, SettingsError& error) {
+    return SettingsParser(data, size, dir, entry, error).document();
+  }
+  static bool parseFile(const fs::path& file, const fs::path& dir, CatalogEntry& entry, SettingsError& error) {
+    // Reused between calls so a warm parse does not allocate for the file contents.
+    thread_local std::string buf;
+    std::ifstream ifs(file, std::ios::binary | std::ios::ate);
+    if (!ifs.is_open()) {
+      error = SettingsError{ 0, 0, "cannot open file" };
+      return false;
+    }
+    buf.resize(static_cast<size_t>(ifs.tellg()));
+    ifs.seekg(0);
+    if (!ifs.read(buf.data(), buf.size())) {
+      error = SettingsError{ 0, 0, "cannot read file" };
+      return false;
+    }
+    return parse(buf.data(), buf.size(), dir, entry, error);
+  }
+};
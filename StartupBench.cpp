@@ -0,0 +1,452 @@
+// Generates a synthetic Games/ tree and times each step of the launcher's startup over it, headless, so
+// that startup regressions show up on a build machine and runs can be compared across builds.
+//
+//   g++ -std=c++17 -O2 -pthread -finput-charset=CP932 StartupBench.cpp -o startup-bench
+//   ./startup-bench [--games=1000] [--depth=1] [--files=64] [--icon=256x256] [--detail=1280x720]
+//                   [--broken=0.05] [--seed=1] [--grid=2x4] [--runs=5] [--packed] [--root=DIR]
+//                   [--out=FILE]
+//
+// Every game folder looks like a Unity build: settings.json, autorun.exe, the images and a <name>_Data
+// tree holding --files files, eight to a folder. --depth puts the game folders that many levels below
+// Games/ (at most 4 are scanned), and --broken is the share of games whose settings.json does not parse
+// or fails the schema. --packed then replaces every game folder with a pack (GamePack.h). Each run loads
+// the catalog once without the catalog index ("cold") and once with it ("warm"). Afterwards one game's
+// settings.json is changed, a game folder moved in and then deleted, each picked up by CatalogReloader
+// and applied with Menu::refresh(); parse_one is a single settings.json parsed on its own for comparison.
+// The results go to --out (stdout by default) as one JSON document; a summary goes to stderr.
+//
+// --root (launcher-bench in the temp folder by default) is deleted and generated again on every start; a
+// directory that is neither empty nor marked as made by this bench is left alone.
+//
+// HeadlessPlatform does not decode images, so the image step measures reading the files of the first
+// page (--grid) through AssetLoader and TextureCache, not DxLib's decoder.
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <vector>
+#include <string>
+#include <string_view>
+#include <optional>
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <cstdio>
+#include <cstdint>
+
+#include "Logger.h"
+#include "AssetLoader.h"
+#include "HeadlessPlatform.h"
+#include "Catalog.h"
+#include "CatalogLoader.h"
+#include "TextureCache.h"
+#include "SearchIndex.h"
+#include "CatalogReloader.h"
+#include "Menu.h"
+#include "GamePack.h"
+
+std::optional<std::string_view> Option(int argc, char** argv, std::string_view name) {
+  for (int i = 1; i < argc; ++i) {
+    std::string_view arg = argv[i];
+    if (arg.substr(0, name.size()) == name)return arg.substr(name.size());
+  }
+  return std::nullopt;
+}
+
+struct TreeOptions {
+  size_t games = 1000;
+  int depth = 1;
+  size_t files = 64;
+  int iconWidth = 256, iconHeight = 256;
+  int detailWidth = 1280, detailHeight = 720;
+  double broken = 0.05;
+  uint32_t seed = 1;
+};
+
+// Writes the synthetic tree. Images are uncompressed PNGs; all games share one file per image size
+// through hard links, so a large tree costs little disk while every game still has its own paths.
+class TreeGenerator {
+  const TreeOptions& opt;
+  uint32_t state;
+  size_t brokenCount = 0;
+
+  uint32_t next() {
+    state = state * 1664525u + 1013904223u;
+    return state >> 8;
+  }
+  static uint32_t crc(const std::string& data) {
+    static uint32_t table[256];
+    if (!table[1])
+      for (uint32_t n = 0; n < 256; ++n) {
+        uint32_t c = n;
+        for (int k = 0; k < 8; ++k)c = c & 1 ? 0xedb88320u ^ (c >> 1) : c >> 1;
+        table[n] = c;
+      }
+    uint32_t c = 0xffffffffu;
+    for (unsigned char b : data)c = table[(c ^ b) & 0xff] ^ (c >> 8);
+    return c ^ 0xffffffffu;
+  }
+  static void put32(std::string& out, uint32_t v) {
+    for (int s = 24; s >= 0; s -= 8)out += static_cast<char>(v >> s & 0xff);
+  }
+  static void chunk(std::ostream& os, const char* type, const std::string& data) {
+    std::string body = std::string(type, 4) + data;
+    std::string head;
+    put32(head, static_cast<uint32_t>(data.size()));
+    std::string tail;
+    put32(tail, crc(body));
+    os << head << body << tail;
+  }
+  // An RGB gradient, stored without compression.
+  static void writePng(const fs::path& file, int width, int height) {
+    std::string raw;
+    raw.reserve(static_cast<size_t>(width * 3 + 1) * height);
+    for (int y = 0; y < height; ++y) {
+      raw += '\0';
+      for (int x = 0; x < width; ++x) {
+        raw += static_cast<char>(x * 255 / std::max(1, width - 1));
+        raw += static_cast<char>(y * 255 / std::max(1, height - 1));
+        raw += static_cast<char>(128);
+      }
+    }
+    std::string zlib = "\x78\x01";
+    for (size_t pos = 0; pos < raw.size() || pos == 0;) {
+      size_t n = std::min<size_t>(raw.size() - pos, 65535);
+      bool last = pos + n == raw.size();
+      zlib += static_cast<char>(last ? 1 : 0);
+      zlib += static_cast<char>(n & 0xff);
+      zlib += static_cast<char>(n >> 8);
+      zlib += static_cast<char>(~n & 0xff);
+      zlib += static_cast<char>((~n >> 8) & 0xff);
+      zlib.append(raw, pos, n);
+      pos += n;
+      if (last)break;
+    }
+    uint32_t a = 1, b = 0;
+    for (unsigned char c : raw) {
+      a = (a + c) % 65521;
+      b = (b + a) % 65521;
+    }
+    put32(zlib, b << 16 | a);
+
+    std::string ihdr;
+    put32(ihdr, static_cast<uint32_t>(width));
+    put32(ihdr, static_cast<uint32_t>(height));
+    ihdr += std::string("\x08\x02\x00\x00\x00", 5);
+    std::ofstream os(file, std::ios::binary);
+    os << "\x89PNG\r\n\x1a\n";
+    chunk(os, "IHDR", ihdr);
+    chunk(os, "IDAT", zlib);
+    chunk(os, "IEND", "");
+  }
+  static void link(const fs::path& from, const fs::path& to) {
+    std::error_code ec;
+    fs::create_hard_link(from, to, ec);
+    if (ec)fs::copy_file(from, to, fs::copy_options::overwrite_existing);
+  }
+  static std::string json(const std::wstring& s) {
+    std::string out;
+    for (wchar_t c : s) {
+      if (c < 0x80)out += static_cast<char>(c);
+      else if (c < 0x800) {
+        out += static_cast<char>(0xc0 | c >> 6);
+        out += static_cast<char>(0x80 | (c & 0x3f));
+      }
+      else {
+        out += static_cast<char>(0xe0 | c >> 12);
+        out += static_cast<char>(0x80 | (c >> 6 & 0x3f));
+        out += static_cast<char>(0x80 | (c & 0x3f));
+      }
+    }
+    return out;
+  }
+  // Games/set<i/256>/set<i/16>/game<i> for depth 3: at most 16 games per folder at the lowest level.
+  fs::path gameDir(const fs::path& games, size_t i) const {
+    fs::path dir = games;
+    size_t span = 1;
+    for (int level = 1; level < opt.depth; ++level)span *= 16;
+    for (int level = opt.depth - 1; level >= 1; --level) {
+      span /= 16;
+      dir /= "set" + std::to_string(i / (span * 16));
+    }
+    return dir / ("game" + std::to_string(i));
+  }
+  std::string settings(size_t i, bool broken) {
+    std::wstring n = std::to_wstring(i);
+    std::ostringstream os;
+    os << "{\n"
+      << "  \"title\": \"" << json(L"Q[" + n) << "\",\n"
+      << "  \"version\": \"1." << i % 10 << "\",\n"
+      << "  \"description\": \"" << json(L"x`}[NpɐQ[" + n + L"̐łB") << "\",\n"
+      << "  \"executable\": \"autorun.exe\",\n"
+      << "  \"icon\": \"image/icon.png\",\n"
+      << "  \"detail\": { \"file\": \"image/detail.png\", \"is_movie\": false },\n";
+    if (!broken) {
+      os << "  \"difficulty\": " << static_cast<int>(next() % 4) - 1 << "\n}\n";
+      return os.str();
+    }
+    switch (next() % 3) {
+    case 0: os << "  \"difficulty\": 7\n}\n"; break;
+    case 1: os << "  \"difficulty\": \"easy\"\n}\n"; break;
+    default: os << "  \"difficulty\": 1,\n"; break;
+    }
+    return os.str();
+  }
+public:
+  explicit TreeGenerator(const TreeOptions& opt) : opt(opt), state(opt.seed) {}
+  size_t broken() const {
+    return brokenCount;
+  }
+
+  // Written into the root so that a later run knows the directory is its own to delete.
+  static constexpr const char* Marker = ".startup-bench";
+
+  // Refuses to touch a root that holds anything but a tree generated earlier.
+  bool generate(const fs::path& root) {
+    std::error_code ec;
+    if (!fs::is_empty(root, ec) && !ec && !fs::exists(root / Marker, ec))return false;
+    fs::remove_all(root);
+    fs::path games = root / "Games";
+    fs::create_directories(games);
+    std::ofstream(root / Marker);
+    fs::path icon = root / "icon.png", detail = root / "detail.png", blob = root / "blob.bin";
+    writePng(icon, opt.iconWidth, opt.iconHeight);
+    writePng(detail, opt.detailWidth, opt.detailHeight);
+    // Starts like a program, for CatalogVerifier.
+    std::ofstream(blob, std::ios::binary) << "MZ" << std::string(4094, 'x');
+
+    brokenCount = 0;
+    for (size_t i = 0; i < opt.games; ++i) {
+      fs::path dir = gameDir(games, i);
+      fs::create_directories(dir / "image");
+      bool broken = (next() % 10000) < opt.broken * 10000;
+      if (broken)++brokenCount;
+      std::ofstream(dir / "settings.json", std::ios::binary) << settings(i, broken);
+      link(blob, dir / "autorun.exe");
+      link(icon, dir / "image/icon.png");
+      link(detail, dir / "image/detail.png");
+      fs::path data = dir / ("game" + std::to_string(i) + "_Data");
+      for (size_t f = 0; f < opt.files; ++f) {
+        fs::path sub = data;
+        for (size_t d = f / 8; d > 0; d /= 8)sub /= "d" + std::to_string(d % 8);
+        fs::create_directories(sub);
+        link(blob, sub / ("asset" + std::to_string(f) + ".bin"));
+      }
+    }
+    return true;
+  }
+};
+
+struct Run {
+  std::string mode;
+  int run;
+  CatalogLoadStats load;
+  long long searchUs = 0;
+  long long imagesUs = 0;
+  size_t images = 0;
+  long long totalUs() const {
+    return load.scanUs + load.parseUs + load.sortUs + load.saveUs + searchUs + imagesUs;
+  }
+};
+
+long long Median(std::vector<long long> v) {
+  if (v.empty())return 0;
+  std::nth_element(v.begin(), v.begin() + v.size() / 2, v.end());
+  return v[v.size() / 2];
+}
+
+int main(int argc, char** argv) {
+  TreeOptions tree;
+  auto number = [&](const char* name, auto& value) {
+    if (auto v = Option(argc, argv, name))value = static_cast<std::remove_reference_t<decltype(value)>>(atof(std::string(*v).c_str()));
+  };
+  auto size = [&](const char* name, int& w, int& h) {
+    if (auto v = Option(argc, argv, name))
+      if (sscanf(std::string(*v).c_str(), "%dx%d", &w, &h) != 2 || w <= 0 || h <= 0)return false;
+    return true;
+  };
+  number("--games=", tree.games);
+  number("--depth=", tree.depth);
+  number("--files=", tree.files);
+  number("--broken=", tree.broken);
+  number("--seed=", tree.seed);
+  if (!size("--icon=", tree.iconWidth, tree.iconHeight) || !size("--detail=", tree.detailWidth, tree.detailHeight)) {
+    std::cerr << "sizes are given as WxH\n";
+    return 2;
+  }
+  tree.depth = std::max(1, tree.depth);
+  int rows = 2, cols = 4;
+  if (!size("--grid=", rows, cols)) {
+    std::cerr << "the grid is given as RxC\n";
+    return 2;
+  }
+  int runs = 5;
+  number("--runs=", runs);
+  fs::path root = fs::temp_directory_path() / "launcher-bench";
+  if (auto value = Option(argc, argv, "--root="))root = std::string(*value);
+
+  auto generateStart = std::chrono::steady_clock::now();
+  TreeGenerator generator(tree);
+  if (!generator.generate(root)) {
+    std::cerr << root.string() << " is neither empty nor a tree made by this bench; give an empty --root\n";
+    return 2;
+  }
+  bool packed = static_cast<bool>(Option(argc, argv, "--packed"));
+  if (packed)
+    for (const auto& dir : GameScanner().scan(root / "Games").gameDirs) {
+      fs::path pack = dir;
+      pack += GamePack::Extension;
+      std::string error;
+      if (!PackWriter::write(dir, pack, true, error)) {
+        std::cerr << error << '\n';
+        return 2;
+      }
+      fs::remove_all(dir);
+    }
+  auto generateMs = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - generateStart).count();
+
+  auto logger = std::make_shared<Logger>(std::cerr);
+  logger->setLevel(Logger::Error);
+  HeadlessPlatform platform;
+  fs::path gameDir = root / "Games", indexFile = root / "catalog.idx";
+  std::vector<Run> results;
+  for (int r = 0; r < runs; ++r) {
+    for (bool warm : { false, true }) {
+      if (!warm)fs::remove(indexFile);
+      Run run;
+      run.mode = warm ? "warm" : "cold";
+      run.run = r;
+      Catalog games;
+      run.load = LoadCatalog(gameDir, indexFile, games, logger);
+
+      auto start = std::chrono::steady_clock::now();
+      SearchIndex search;
+      search.build(games, {});
+      auto built = std::chrono::steady_clock::now();
+      run.searchUs = std::chrono::duration_cast<std::chrono::microseconds>(built - start).count();
+
+      // The first page: its icons and the detail image of the selected game.
+      GamePacks packs;
+      AssetLoader assets(2, &packs);
+      TextureCache textures(platform, games, assets, logger, SIZE_MAX);
+      size_t page = std::min(games.size(), static_cast<size_t>(rows * cols));
+      for (size_t i = 0; i < page; ++i)textures.want(static_cast<uint32_t>(i * 2), AssetLoader::Visible);
+      if (page > 0)textures.want(1, AssetLoader::Visible);
+      size_t pending = page + (page > 0);
+      for (uint32_t key; pending > 0;) {
+        if (textures.pump(key))--pending;
+        else std::this_thread::yield();
+      }
+      run.imagesUs = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - built).count();
+      run.images = textures.stats().resident;
+      results.push_back(run);
+    }
+  }
+
+  struct Reload {
+    const char* name;
+    long long us;
+    size_t changed;
+  };
+  std::vector<Reload> reloads;
+  {
+    Catalog games;
+    LoadCatalog(gameDir, indexFile, games, logger);
+    SearchIndex search;
+    search.build(games, {});
+    GamePacks packs;
+    AssetLoader assets(2, &packs);
+    TextureCache textures(platform, games, assets, logger, SIZE_MAX);
+    Menu::Options options;
+    options.rows = rows;
+    options.cols = cols;
+    Menu menu(platform, games, search, textures, logger, 1920, 1080, options);
+    CatalogReloader reloader(gameDir, games, &search, logger, std::chrono::milliseconds(50));
+    auto step = [&](const char* name, auto change) {
+      change();
+      std::vector<uint32_t> changed;
+      auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(5);
+      while (!reloader.poll(changed) && std::chrono::steady_clock::now() < deadline)
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+      auto start = std::chrono::steady_clock::now();
+      menu.refresh(changed);
+      long long refreshUs = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start).count();
+      reloads.push_back({ name, changed.empty() ? -1 : reloader.stats().lastUs + refreshUs, changed.size() });
+    };
+    if (!games.empty()) {
+      fs::path target = games.dir(games.size() / 2);
+      fs::path added = gameDir / (packed ? "added.lpk" : "added"), staging = root / "staging";
+      // For comparison, parsing the same file once on its own, outside the tight loop of a full load.
+      std::this_thread::sleep_for(std::chrono::milliseconds(50));
+      auto start = std::chrono::steady_clock::now();
+      CatalogEntry entry;
+      ReadSettings(target, entry, logger);
+      reloads.push_back({ "parse_one", std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start).count(), 1 });
+      step("update", [&] {
+        if (!packed)std::ofstream(target / "settings.json", std::ios::app) << "\n";
+        else {
+          fs::copy_file(target, staging);
+          fs::rename(staging, target);
+        }
+      });
+      step("add", [&] {
+        fs::copy(target, staging, fs::copy_options::recursive);
+        fs::rename(staging, added);
+      });
+      step("remove", [&] { fs::remove_all(added); });
+    }
+  }
+  logger->close();
+
+  std::ostringstream json;
+  json << "{\n  \"params\": {\"games\": " << tree.games << ", \"depth\": " << tree.depth << ", \"files\": " << tree.files
+    << ", \"icon\": \"" << tree.iconWidth << "x" << tree.iconHeight << "\", \"detail\": \"" << tree.detailWidth << "x"
+    << tree.detailHeight << "\", \"broken\": " << tree.broken << ", \"seed\": " << tree.seed << ", \"runs\": " << runs << ", \"packed\": " << (packed ? "true" : "false") << "},\n"
+    << "  \"tree\": {\"broken\": " << generator.broken() << ", \"generate_ms\": " << generateMs << "},\n  \"runs\": [\n";
+  for (size_t i = 0; i < results.size(); ++i) {
+    const Run& run = results[i];
+    json << "    {\"mode\": \"" << run.mode << "\", \"run\": " << run.run << ", \"folders\": " << run.load.folders
+      << ", \"parsed\": " << run.load.parsed << ", \"valid\": " << run.load.valid << ", \"scan_us\": " << run.load.scanUs
+      << ", \"parse_us\": " << run.load.parseUs << ", \"sort_us\": " << run.load.sortUs << ", \"save_us\": " << run.load.saveUs
+      << ", \"search_us\": " << run.searchUs << ", \"images_us\": " << run.imagesUs << ", \"images\": " << run.images
+      << ", \"total_us\": " << run.totalUs() << "}" << (i + 1 < results.size() ? "," : "") << "\n";
+  }
+  json << "  ],\n  \"median\": {";
+  for (const char* mode : { "cold", "warm" }) {
+    std::vector<long long> scan, parse, sort, save, searchUs, images, total;
+    for (const Run& run : results) {
+      if (run.mode != mode)continue;
+      scan.push_back(run.load.scanUs);
+      parse.push_back(run.load.parseUs);
+      sort.push_back(run.load.sortUs);
+      save.push_back(run.load.saveUs);
+      searchUs.push_back(run.searchUs);
+      images.push_back(run.imagesUs);
+      total.push_back(run.totalUs());
+    }
+    json << (mode[0] == 'w' ? ", " : "") << "\"" << mode << "\": {\"scan_us\": " << Median(scan) << ", \"parse_us\": " << Median(parse)
+      << ", \"sort_us\": " << Median(sort) << ", \"save_us\": " << Median(save) << ", \"search_us\": " << Median(searchUs)
+      << ", \"images_us\": " << Median(images) << ", \"total_us\": " << Median(total) << "}";
+    std::cerr << mode << "  scan " << Median(scan) << "us  parse " << Median(parse) << "us  sort " << Median(sort)
+      << "us  save " << Median(save) << "us  search " << Median(searchUs) << "us  images " << Median(images)
+      << "us  total " << Median(total) << "us\n";
+  }
+  json << "},\n  \"reload\": {";
+  std::cerr << "reload";
+  for (size_t i = 0; i < reloads.size(); ++i) {
+    json << (i > 0 ? ", " : "") << "\"" << reloads[i].name << "_us\": " << reloads[i].us;
+    std::cerr << "  " << reloads[i].name << " " << reloads[i].us << "us";
+  }
+  std::cerr << '\n';
+  json << "}\n}\n";
+
+  if (auto value = Option(argc, argv, "--out=")) {
+    std::ofstream out{ std::string(*value) };
+    if (!out.is_open()) {
+      std::cerr << "cannot open " << *value << '\n';
+      return 2;
+    }
+    out << json.str();
+  }
+  else std::cout << json.str();
+  return results.empty() || results.front().load.valid == 0 ? 1 : 0;
+}
@@ -0,0 +1,117 @@
+#pragma once
+#include <string>
+#include <string_view>
+#include <vector>
+#include <unordered_map>
+#include <cstdint>
+
+#include "Platform.h"
+#include "Trace.h"
+
+// Strings rendered once into textures and drawn from there, keyed by text, colour and font size, with
+// their measured size. Entries not drawn for the longest time are deleted once there are more than
+// maxEntries of them or they take more than maxBytes. A string too large for a texture is measured once
+// and drawn as text every time.
+class TextCache {
+public:
+  struct Stats {
+    size_t entries = 0;
+    size_t bytes = 0;
+    size_t renders = 0;
+    size_t evictions = 0;
+  };
+private:
+  struct Entry {
+    std::wstring text;
+    unsigned int color;
+    int font;
+    int handle;
+    int width, height;
+    long long usedAt;
+  };
+  Platform& platform;
+  size_t maxEntries, maxBytes;
+  std::unordered_map<uint64_t, Entry> entries;
+  long long uses = 0;
+  Stats counters;
+
+  static uint64_t hash(std::wstring_view text, unsigned int color, int font) {
+    uint64_t h = 1469598103934665603ull;
+    auto mix = [&h](uint32_t v) {
+      h ^= v;
+      h *= 1099511628211ull;
+    };
+    for (wchar_t c : text)mix(static_cast<uint32_t>(c));
+    mix(color);
+    mix(static_cast<uint32_t>(font));
+    return h;
+  }
+  size_t bytes(const Entry& e) const {
+    return e.handle != -1 ? static_cast<size_t>(e.width) * e.height * 4 : 0;
+  }
+  void erase(std::unordered_map<uint64_t, Entry>::iterator itr) {
+    if (itr->second.handle != -1)platform.deleteGraph(itr->second.handle);
+    counters.bytes -= bytes(itr->second);
+    entries.erase(itr);
+    counters.entries = entries.size();
+  }
+  void evict() {
+    while (entries.size() > maxEntries || counters.bytes > maxBytes) {
+      auto oldest = entries.end();
+      for (auto itr = entries.begin(); itr != entries.end(); ++itr)
+        if (itr->second.usedAt != uses && (oldest == entries.end() || itr->second.usedAt < oldest->second.usedAt))oldest = itr;
+      // Everything left was used just now.
+      if (oldest == entries.end())return;
+      erase(oldest);
+      ++counters.evictions;
+    }
+  }
+  const Entry& get(std::wstring_view text, unsigned int color) {
+    int font = platform.fontSize();
+    uint64_t key = hash(text, color, font);
+    auto itr = entries.find(key);
+    if (itr != entries.end() && (itr->second.text != text || itr->second.color != color || itr->second.font != font))erase(itr);
+    else if (itr != entries.end()) {
+      itr->second.usedAt = ++uses;
+      return itr->second;
+    }
+    TraceSpan span("text");
+    Entry e{ std::wstring(text), color, font, -1, 0, 0, ++uses };
+    e.handle = platform.renderText(e.text.c_str(), color, e.width, e.height);
+    ++counters.renders;
+    counters.bytes += bytes(e);
+    Entry& added = entries.emplace(key, std::move(e)).first->second;
+    counters.entries = entries.size();
+    evict();
+    return added;
+  }
+public:
+  TextCache(Platform& platform, size_t maxEntries = 64, size_t maxBytes = 16 << 20)
+    : platform(platform), maxEntries(maxEntries), maxBytes(maxBytes) {}
+  TextCache(const TextCache&) = delete;
+  TextCache& operator=(const TextCache&) = delete;
+  ~TextCache() {
+    clear();
+  }
+
+  // Lines are split at '\n'.
+  void draw(float x, float y, unsigned int color, std::wstring_view text) {
+    const Entry& e = get(text, color);
+    if (e.handle != -1)platform.drawGraph(x, y, x + e.width, y + e.height, e.handle, true);
+    else if (e.width > 0)platform.text(x, y, color, e.text.c_str());
+  }
+  int width(std::wstring_view text, unsigned int color) {
+    return get(text, color).width;
+  }
+  // Deletes every texture, e.g. while a game runs; strings are rendered again when next drawn.
+  void clear() {
+    for (auto& [key, e] : entries)
+      if (e.handle != -1)platform.deleteGraph(e.handle);
+    entries.clear();
+    counters.entries = 0;
+    counters.bytes = 0;
+  }
+  Stats stats() const {
+    return counters;
+  }
+};
@@ -0,0 +1,322 @@
+#pragma once
+#include <memory>
+#include <vector>
+#include <string>
+#include <cstdint>
+
+#include "Logger.h"
+#include "AssetLoader.h"
+#include "Platform.h"
+#include "Catalog.h"
+#include "ThumbnailAtlas.h"
+#include "Trace.h"
+
+// Keeps the catalog's icons and detail images in video memory within a budget. Slots are keyed like the
+// AssetLoader requests, game * 2 for the icon and game * 2 + 1 for the detail image. Images are read
+// when the menu asks for them; once the resident bytes exceed the budget the least recently used slots
+// that are not pinned (the visible page) are dropped, to be read again if they are needed later.
+// The pixels of resident images stay in memory so that textures can be recreated after a game ran.
+// A movie game's detail slot holds its poster, a still frame handed over by MoviePreview.
+// With an atlas set, icons found in it are drawn from there and never loaded; icons that are loaded are
+// handed to the atlas to be shrunk for the next time.
+class TextureCache {
+public:
+  struct Stats {
+    size_t residentBytes = 0;
+    size_t resident = 0;
+    size_t pinned = 0;
+    size_t loads = 0;
+    size_t evictions = 0;
+    size_t atlased = 0;
+  };
+private:
+  enum State : uint8_t {
+    Empty,
+    Loading,
+    Loaded,
+    Failed,
+    // An icon drawn from the atlas.
+    Atlased
+  };
+  static constexpr uint32_t None = UINT32_MAX;
+  Platform& platform;
+  const Catalog& games;
+  AssetLoader& assets;
+  std::shared_ptr<Logger> logger;
+  size_t budget;
+
+  std::vector<State> state;
+  // The generation of a slot's pending read; reads of any other generation are dropped when they arrive.
+  std::vector<uint32_t> generation;
+  uint32_t issued = 0;
+  std::vector<uint8_t> pinned;
+  std::vector<int> handle;
+  std::vector<std::shared_ptr<const Pixels>> pixels;
+  std::vector<int> width, height;
+  // Loaded slots, most recently used first.
+  std::vector<uint32_t> prev, next;
+  uint32_t head = None, tail = None;
+  std::vector<uint32_t> pins;
+  ThumbnailAtlas* atlas = nullptr;
+  // By game: the atlas key of the icon as it was when it was wanted, and where it sits in the atlas.
+  std::vector<uint64_t> atlasKey;
+  std::vector<ThumbnailAtlas::Region> region;
+
+  std::shared_ptr<const Pixels> placeholderPixels;
+  int placeholder = -1;
+  bool suspended = false;
+  Stats counters;
+
+  size_t bytes(uint32_t key) const {
+    return static_cast<size_t>(width[key]) * height[key] * 4;
+  }
+  void unlink(uint32_t key) {
+    (prev[key] != None ? next[prev[key]] : head) = next[key];
+    (next[key] != None ? prev[next[key]] : tail) = prev[key];
+    prev[key] = next[key] = None;
+  }
+  void pushFront(uint32_t key) {
+    prev[key] = None;
+    next[key] = head;
+    (head != None ? prev[head] : tail) = key;
+    head = key;
+  }
+  void upload(uint32_t key) {
+    if (pixels[key])handle[key] = platform.createTexture(*pixels[key]);
+  }
+  void insert(uint32_t key) {
+    if (!suspended)upload(key);
+    state[key] = Loaded;
+    counters.residentBytes += bytes(key);
+    ++counters.resident;
+    ++counters.loads;
+    pushFront(key);
+    evict();
+  }
+  void drop(uint32_t key) {
+    if (handle[key] != -1)platform.deleteGraph(handle[key]);
+    handle[key] = -1;
+    pixels[key].reset();
+    counters.residentBytes -= bytes(key);
+    --counters.resident;
+    width[key] = height[key] = 0;
+    unlink(key);
+    state[key] = Empty;
+  }
+  void evict() {
+    for (uint32_t key = tail; key != None && counters.residentBytes > budget;) {
+      uint32_t p = prev[key];
+      if (!pinned[key]) {
+        drop(key);
+        ++counters.evictions;
+      }
+      key = p;
+    }
+  }
+public:
+  TextureCache(Platform& platform, const Catalog& games, AssetLoader& assets, std::shared_ptr<Logger> logger, size_t budget)
+    : platform(platform), games(games), assets(assets), logger(logger), budget(budget) {
+    reset();
+  }
+  TextureCache(const TextureCache&) = delete;
+  TextureCache& operator=(const TextureCache&) = delete;
+
+  // Drops everything; called when the catalog was rebuilt.
+  void reset() {
+    for (size_t key = 0; key < handle.size(); ++key)
+      if (handle[key] != -1)platform.deleteGraph(handle[key]);
+    size_t n = games.size() * 2;
+    state.assign(n, Empty);
+    generation.assign(n, 0);
+    pinned.assign(n, 0);
+    handle.assign(n, -1);
+    pixels.assign(n, nullptr);
+    width.assign(n, 0);
+    height.assign(n, 0);
+    prev.assign(n, None);
+    next.assign(n, None);
+    atlasKey.assign(games.size(), 0);
+    region.assign(games.size(), ThumbnailAtlas::Region{});
+    head = tail = None;
+    pins.clear();
+    size_t loads = counters.loads, evictions = counters.evictions;
+    counters = Stats();
+    counters.loads = loads;
+    counters.evictions = evictions;
+  }
+  // Makes room for games added to the catalog since the last reset().
+  void grow() {
+    size_t n = games.size() * 2;
+    if (n <= state.size())return;
+    state.resize(n, Empty);
+    generation.resize(n, 0);
+    pinned.resize(n, 0);
+    handle.resize(n, -1);
+    pixels.resize(n);
+    width.resize(n, 0);
+    height.resize(n, 0);
+    prev.resize(n, None);
+    next.resize(n, None);
+    atlasKey.resize(games.size(), 0);
+    region.resize(games.size());
+  }
+  // Forgets a game's images because its files changed; they are read again when next wanted. A read
+  // still in flight is dropped when it arrives, even if the slot is loading again by then.
+  void invalidate(size_t game) {
+    for (uint32_t key : { static_cast<uint32_t>(game * 2), static_cast<uint32_t>(game * 2 + 1) }) {
+      if (state[key] == Loaded)drop(key);
+      if (state[key] == Atlased)--counters.atlased;
+      state[key] = Empty;
+      generation[key] = 0;
+    }
+  }
+  // Icons wanted from now on are looked up in the atlas first.
+  void setAtlas(ThumbnailAtlas* a) {
+    atlas = a;
+  }
+  // Drawn in place of an image that is not resident (or failed to load).
+  void setPlaceholder(std::shared_ptr<const Pixels> p) {
+    if (placeholder != -1)platform.deleteGraph(placeholder);
+    placeholderPixels = p;
+    placeholder = p && !suspended ? platform.createTexture(*p) : -1;
+  }
+
+  // Where the game's icon sits in the atlas, if it is drawn from there.
+  bool thumb(size_t game, ThumbnailAtlas::Region& r) const {
+    if (state[game * 2] != Atlased)return false;
+    r = region[game];
+    return true;
+  }
+  int atlasPage(int page) {
+    return atlas ? atlas->texture(page) : -1;
+  }
+  int placeholderHandle() const {
+    return placeholder;
+  }
+  int icon(size_t game) const {
+    return handle[game * 2] != -1 ? handle[game * 2] : placeholder;
+  }
+  int detail(size_t game) const {
+    return handle[game * 2 + 1] != -1 ? handle[game * 2 + 1] : placeholder;
+  }
+  void detailSize(size_t game, int& w, int& h) const {
+    size_t key = game * 2 + 1;
+    if (handle[key] != -1) {
+      w = width[key];
+      h = height[key];
+    }
+    else if (placeholder != -1)platform.graphSize(placeholder, w, h);
+    else w = h = 1;
+  }
+
+  // Starts loading a slot at the given priority, or changes the priority of a pending load. Background
+  // only lowers a pending load and never starts one.
+  void want(uint32_t key, AssetLoader::Priority priority) {
+    if (state[key] == Loading)assets.prioritize(key, priority);
+    else if (state[key] == Empty && priority != AssetLoader::Background) {
+      size_t game = key / 2;
+      bool isDetail = key % 2 == 1;
+      if (isDetail && games.isMovie(game))return;
+      if (!isDetail && atlas) {
+        atlasKey[game] = ThumbnailAtlas::key(games.icon(game));
+        if (atlas->find(atlasKey[game], region[game])) {
+          state[key] = Atlased;
+          ++counters.atlased;
+          return;
+        }
+      }
+      state[key] = Loading;
+      // 0 is never issued; it marks a slot without a pending read.
+      if (++issued == 0)++issued;
+      generation[key] = issued;
+      assets.request(key, issued, isDetail ? games.detail(game) : games.icon(game), priority);
+    }
+  }
+  // Replaces the poster of a movie game.
+  void setPoster(size_t game, std::shared_ptr<const Pixels> poster) {
+    uint32_t key = static_cast<uint32_t>(game * 2 + 1);
+    if (state[key] == Loaded)drop(key);
+    pixels[key] = poster;
+    width[key] = poster->width;
+    height[key] = poster->height;
+    insert(key);
+  }
+  // Pins exactly the given slots; slots that lose their pin count as just used.
+  void pin(const std::vector<uint32_t>& keys) {
+    for (uint32_t key : pins) {
+      pinned[key] = 0;
+      if (state[key] == Loaded) {
+        unlink(key);
+        pushFront(key);
+      }
+    }
+    pins = keys;
+    for (uint32_t key : pins)pinned[key] = 1;
+    counters.pinned = pins.size();
+    evict();
+  }
+
+  // Takes one finished read from the loader and makes it resident. Returns false if none was ready.
+  bool pump(uint32_t& key) {
+    AssetLoader::Loaded item;
+    while (assets.pop(item)) {
+      key = static_cast<uint32_t>(item.key);
+      assets.finish(item);
+      // Requested before the catalog was reset or the slot was invalidated.
+      if (key >= state.size() || state[key] != Loading || item.generation != generation[key])continue;
+      TraceSpan span("decode");
+      if (!item.ok) {
+        if (!fs::exists(item.path))logger->err(item.path.string() + "݂܂B");
+        else logger->err(item.path.string() + "J܂ł");
+        state[key] = Failed;
+        return true;
+      }
+      pixels[key] = item.pack ? platform.decodeImage(item.view.data(), item.view.size()) : platform.decodeImage(item.data.data(), item.data.size());
+      if (!pixels[key]) {
+        logger->err(item.path.string() + "J܂ł");
+        state[key] = Failed;
+        return true;
+      }
+      width[key] = pixels[key]->width;
+      height[key] = pixels[key]->height;
+      if (atlas && key % 2 == 0)atlas->add(atlasKey[key / 2], pixels[key]);
+      insert(key);
+      return true;
+    }
+    return false;
+  }
+
+  // Frees the video memory while a game runs; restore() brings back what was resident.
+  void release() {
+    for (uint32_t key = head; key != None; key = next[key]) {
+      if (handle[key] != -1)platform.deleteGraph(handle[key]);
+      handle[key] = -1;
+    }
+    if (placeholder != -1)platform.deleteGraph(placeholder);
+    placeholder = -1;
+    if (atlas) {
+      atlas->release();
+      atlas->pause(true);
+    }
+    suspended = true;
+  }
+  void restore() {
+    suspended = false;
+    if (atlas)atlas->pause(false);
+    if (placeholderPixels)placeholder = platform.createTexture(*placeholderPixels);
+    for (uint32_t key = head; key != None; key = next[key])upload(key);
+  }
+
+  size_t budgetBytes() const {
+    return budget;
+  }
+  Stats stats() const {
+    return counters;
+  }
+  // "12, 34MB/256MB, Ǎ56, j7[, AgX89]"
+  std::string str() const {
+    return std::to_string(counters.resident) + ", " + std::to_string(counters.residentBytes >> 20) + "MB/"
+      + std::to_string(budget >> 20) + "MB, Ǎ" + std::to_string(counters.loads) + ", j" + std::to_string(counters.evictions) + ""
+      + (atlas ? ", AgX" + std::to_string(counters.atlased) + "" : "");
+  }
+};
@@ -0,0 +1,71 @@
+#pragma once
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <deque>
+#include <vector>
+#include <algorithm>
+
+class ThreadPool {
+private:
+  std::vector<std::thread> workers;
+  std::deque<std::function<void()>> tasks;
+  std::mutex mtx;
+  std::condition_variable taskCv;
+  std::condition_variable idleCv;
+  size_t active = 0;
+  bool quit = false;
+
+  void run() {
+    for (;;) {
+      std::function<void()> task;
+      {
+        std::unique_lock<std::mutex> lock(mtx);
+        taskCv.wait(lock, [this] { return quit || !tasks.empty(); });
+        if (quit && tasks.empty())return;
+        task = std::move(tasks.front());
+        tasks.pop_front();
+        ++active;
+      }
+      task();
+      {
+        std::lock_guard<std::mutex> lock(mtx);
+        --active;
+        if (active == 0 && tasks.empty())idleCv.notify_all();
+      }
+    }
+  }
+public:
+  explicit ThreadPool(size_t threads = 0) {
+    if (threads == 0)threads = std::max(1u, std::thread::hardware_concurrency());
+    workers.reserve(threads);
+    for (size_t i = 0; i < threads; ++i)
+      workers.emplace_back([this] { run(); });
+  }
+  ThreadPool(const ThreadPool&) = delete;
+  ThreadPool& operator=(const ThreadPool&) = delete;
+  ~ThreadPool() {
+    {
+      std::lock_guard<std::mutex> lock(mtx);
+      quit = true;
+    }
+    taskCv.notify_all();
+    for (auto& t : workers)t.join();
+  }
+  // Tasks may post further tasks; wait() returns once all of them have finished.
+  void post(std::function<void()> task) {
+    {
+      std::lock_guard<std::mutex> lock(mtx);
+      tasks.push_back(std::move(task));
+    }
+    taskCv.notify_one();
+  }
+  void wait() {
+    std::unique_lock<std::mutex> lock(mtx);
+    idleCv.wait(lock, [this] { return active == 0 && tasks.empty(); });
+  }
+  size_t size() const {
+    return workers.size();
+  }
+};
@@ -0,0 +1,477 @@
+#pragma once
+#include <filesystem>
+#include <memory>
+#include <vector>
+#include <deque>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define THUMBNAIL_SSE2
+#endif
+
+#include "Platform.h"
+#include "Trace.h"
+#include "GamePack.h"
+
+namespace fs = std::filesystem;
+
+// Icons shrunk to the size of a grid cell, packed into square pages of a memory-mapped file and keyed by
+// the icon file's path, size and modification time. An icon found here needs neither reading nor
+// decoding, and all icons on one atlas page are drawn with a single Platform::drawQuads() call.
+// Icons that are not in the atlas yet are added from the decoded images the TextureCache hands over:
+// shrinking and writing happen on a worker thread of their own, so the atlas fills up as the menu is
+// browsed (or all at once with --build-atlas). Every cell size has a file of its own.
+// Thumbnails are stored with premultiplied alpha.
+class ThumbnailAtlas {
+public:
+  static constexpr int PageSize = 2048;
+  static constexpr uint32_t MaxThumbs = 8192;
+  struct Region {
+    int page;
+    float u1, v1, u2, v2;
+  };
+private:
+  static constexpr char Magic[4] = { 'L', 'T', 'A', 'T' };
+  static constexpr uint32_t Version = 1;
+  static constexpr uint32_t TableSize = MaxThumbs * 2;
+  struct Header {
+    char magic[4];
+    uint32_t version;
+    uint32_t thumbWidth;
+    uint32_t thumbHeight;
+    uint32_t pageSize;
+    uint32_t pages;
+    uint32_t thumbs;
+    uint32_t reserved;
+  };
+  // Open addressing on the key; key 0 is an empty entry.
+  struct Entry {
+    uint64_t key;
+    uint32_t slot;
+    uint32_t reserved;
+  };
+  static_assert(sizeof(Header) == 32 && sizeof(Entry) == 16, "file layout");
+  static constexpr size_t PageBytes = static_cast<size_t>(PageSize) * PageSize * 4;
+  // Pages start on a 64KB boundary, as MapViewOfFile offsets must.
+  static constexpr uint64_t PagesOffset = (sizeof(Header) + sizeof(Entry) * TableSize + 0xffff) & ~static_cast<uint64_t>(0xffff);
+
+  struct Job {
+    uint64_t key;
+    std::shared_ptr<const Pixels> pixels;
+  };
+
+  Platform& platform;
+  int thumbWidth, thumbHeight;
+  int perRow, perPage;
+  size_t maxResident;
+
+  std::mutex mtx;
+  std::condition_variable cv, doneCv;
+#ifdef _WIN32
+  HANDLE file = INVALID_HANDLE_VALUE;
+  HANDLE mapping = NULL;
+#else
+  int fd = -1;
+#endif
+  void* view = nullptr;
+  Header* header = nullptr;
+  Entry* table = nullptr;
+
+  std::deque<Job> jobs;
+  bool busy = false;
+  bool paused = false;
+  bool quit = false;
+  std::thread worker;
+
+  // Page textures, main thread only. stale is set by the worker when it adds to a page.
+  std::vector<int> textures;
+  std::vector<uint8_t> stale;
+  std::vector<long long> usedAt;
+  long long uses = 0;
+
+  uint64_t size(uint32_t pages) const {
+    return PagesOffset + static_cast<uint64_t>(pages) * PageBytes;
+  }
+  // Makes the file hold the given number of pages.
+  bool resize(uint32_t pages) {
+#ifdef _WIN32
+    uint64_t bytes = size(pages);
+    HANDLE m = CreateFileMappingW(file, NULL, PAGE_READWRITE, static_cast<DWORD>(bytes >> 32), static_cast<DWORD>(bytes), NULL);
+    if (m == NULL)return false;
+    // Views taken from the old mapping stay valid.
+    if (mapping != NULL)CloseHandle(mapping);
+    mapping = m;
+    return true;
+#else
+    return ftruncate(fd, static_cast<off_t>(size(pages))) == 0;
+#endif
+  }
+  void* map(uint64_t offset, size_t bytes) {
+#ifdef _WIN32
+    return MapViewOfFile(mapping, FILE_MAP_ALL_ACCESS, static_cast<DWORD>(offset >> 32), static_cast<DWORD>(offset), bytes);
+#else
+    void* p = mmap(nullptr, bytes, PROT_READ | PROT_WRITE, MAP_SHARED, fd, static_cast<off_t>(offset));
+    return p == MAP_FAILED ? nullptr : p;
+#endif
+  }
+  static void unmap(void* p, size_t bytes) {
+#ifdef _WIN32
+    UnmapViewOfFile(p);
+#else
+    munmap(p, bytes);
+#endif
+  }
+  Entry* lookup(uint64_t key) {
+    for (uint32_t i = static_cast<uint32_t>(key) & (TableSize - 1);; i = (i + 1) & (TableSize - 1))
+      if (table[i].key == key || table[i].key == 0)return &table[i];
+  }
+
+  void run() {
+    Trace::nameThread("ThumbnailAtlas");
+    std::vector<unsigned int> thumb(static_cast<size_t>(thumbWidth) * thumbHeight);
+    for (;;) {
+      Job job;
+      {
+        std::unique_lock<std::mutex> lock(mtx);
+        busy = false;
+        doneCv.notify_all();
+        cv.wait(lock, [this] { return quit || (!paused && !jobs.empty()); });
+        if (quit)return;
+        job = std::move(jobs.front());
+        jobs.pop_front();
+        busy = true;
+      }
+      if (contains(job.key))continue;
+      {
+        TraceSpan span("shrink");
+        shrink(*job.pixels, thumb.data(), thumbWidth, thumbHeight);
+      }
+      std::lock_guard<std::mutex> lock(mtx);
+      if (!header || header->thumbs >= MaxThumbs)continue;
+      uint32_t slot = header->thumbs;
+      uint32_t page = slot / perPage;
+      if (page >= header->pages) {
+        if (!resize(page + 1))continue;
+        header->pages = page + 1;
+      }
+      char* base = static_cast<char*>(map(size(page), PageBytes));
+      if (!base)continue;
+      int x = slot % perPage % perRow * thumbWidth, y = slot % perPage / perRow * thumbHeight;
+      for (int row = 0; row < thumbHeight; ++row)
+        std::memcpy(base + (static_cast<size_t>(y + row) * PageSize + x) * 4, &thumb[static_cast<size_t>(row) * thumbWidth], thumbWidth * 4);
+      unmap(base, PageBytes);
+      *lookup(job.key) = Entry{ job.key, slot, 0 };
+      ++header->thumbs;
+      if (page < stale.size())stale[page] = 1;
+    }
+  }
+public:
+  // At most maxResident pages are kept as textures; the least recently drawn one makes way.
+  ThumbnailAtlas(Platform& platform, int thumbWidth, int thumbHeight, size_t maxResident = 4)
+    : platform(platform), thumbWidth(std::clamp(thumbWidth, 1, PageSize)), thumbHeight(std::clamp(thumbHeight, 1, PageSize))
+    , maxResident(std::max<size_t>(maxResident, 1)) {
+    perRow = PageSize / this->thumbWidth;
+    perPage = perRow * (PageSize / this->thumbHeight);
+    worker = std::thread([this] { run(); });
+  }
+  ThumbnailAtlas(const ThumbnailAtlas&) = delete;
+  ThumbnailAtlas& operator=(const ThumbnailAtlas&) = delete;
+  ~ThumbnailAtlas() {
+    {
+      std::lock_guard<std::mutex> lock(mtx);
+      quit = true;
+    }
+    cv.notify_all();
+    worker.join();
+    close();
+  }
+
+  // Identifies an icon file by path, size and modification time; 0 if it cannot be read. An icon in a pack
+  // goes by the size and time of the pack.
+  static uint64_t key(const fs::path& file) {
+    std::error_code ec;
+    fs::path stamped = file;
+    std::string name;
+    uint64_t bytes = fs::file_size(stamped, ec);
+    if (ec && GamePack::split(file, stamped, name))bytes = fs::file_size(stamped, ec);
+    if (ec)return 0;
+    auto time = fs::last_write_time(stamped, ec);
+    if (ec)return 0;
+    uint64_t h = 1469598103934665603ull;
+    auto mix = [&h](uint64_t v) {
+      for (int i = 0; i < 8; ++i, v >>= 8) {
+        h ^= v & 0xff;
+        h *= 1099511628211ull;
+      }
+    };
+    for (wchar_t c : file.wstring())mix(static_cast<uint16_t>(c));
+    mix(bytes);
+    mix(static_cast<uint64_t>(time.time_since_epoch().count()));
+    return h != 0 ? h : 1;
+  }
+
+  // Scales src to w x h with premultiplied alpha. Every destination pixel is the average of the source
+  // pixels it covers (the nearest one when enlarging); the channels of a pixel are summed in one SSE2
+  // register, two source pixels at a time.
+  static void shrink(const Pixels& src, unsigned int* dst, int w, int h) {
+    if (src.width <= 0 || src.height <= 0) {
+      std::fill(dst, dst + static_cast<size_t>(w) * h, 0u);
+      return;
+    }
+    std::vector<int> xs(w + 1);
+    for (int x = 0; x <= w; ++x)xs[x] = static_cast<int>(static_cast<long long>(x) * src.width / w);
+#ifdef THUMBNAIL_SSE2
+    const __m128i zero = _mm_setzero_si128();
+    // Colour lanes are multiplied by alpha, the alpha lanes by 255 so that every lane ends up divided alike.
+    const __m128i colorMask = _mm_set_epi16(0, -1, -1, -1, 0, -1, -1, -1);
+    const __m128i alphaOne = _mm_set_epi16(255, 0, 0, 0, 255, 0, 0, 0);
+#endif
+    for (int y = 0; y < h; ++y) {
+      int y0 = static_cast<int>(static_cast<long long>(y) * src.height / h);
+      int y1 = std::max(y0 + 1, static_cast<int>(static_cast<long long>(y + 1) * src.height / h));
+      for (int x = 0; x < w; ++x) {
+        int x0 = xs[x], x1 = std::max(x0 + 1, xs[x + 1]);
+        float scale = 1.f / (255.f * (x1 - x0) * (y1 - y0));
+#ifdef THUMBNAIL_SSE2
+        __m128i acc = zero;
+        for (int sy = y0; sy < y1; ++sy) {
+          const unsigned int* row = &src.argb[static_cast<size_t>(sy) * src.width];
+          int sx = x0;
+          for (; sx + 2 <= x1; sx += 2) {
+            __m128i p = _mm_unpacklo_epi8(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(row + sx)), zero);
+            __m128i a = _mm_shufflehi_epi16(_mm_shufflelo_epi16(p, 0xff), 0xff);
+            p = _mm_mullo_epi16(p, _mm_or_si128(_mm_and_si128(a, colorMask), alphaOne));
+            acc = _mm_add_epi32(acc, _mm_add_epi32(_mm_unpacklo_epi16(p, zero), _mm_unpackhi_epi16(p, zero)));
+          }
+          if (sx < x1) {
+            __m128i p = _mm_unpacklo_epi8(_mm_cvtsi32_si128(static_cast<int>(row[sx])), zero);
+            __m128i a = _mm_shufflelo_epi16(p, 0xff);
+            p = _mm_mullo_epi16(p, _mm_or_si128(_mm_and_si128(a, colorMask), alphaOne));
+            acc = _mm_add_epi32(acc, _mm_unpacklo_epi16(p, zero));
+          }
+        }
+        __m128i v = _mm_cvttps_epi32(_mm_add_ps(_mm_mul_ps(_mm_cvtepi32_ps(acc), _mm_set1_ps(scale)), _mm_set1_ps(0.5f)));
+        v = _mm_packs_epi32(v, v);
+        dst[static_cast<size_t>(y) * w + x] = static_cast<unsigned int>(_mm_cvtsi128_si32(_mm_packus_epi16(v, v)));
+#else
+        uint32_t acc[4] = {};
+        for (int sy = y0; sy < y1; ++sy) {
+          const unsigned int* row = &src.argb[static_cast<size_t>(sy) * src.width];
+          for (int sx = x0; sx < x1; ++sx) {
+            uint32_t p = row[sx], a = p >> 24;
+            acc[0] += (p & 0xff) * a;
+            acc[1] += (p >> 8 & 0xff) * a;
+            acc[2] += (p >> 16 & 0xff) * a;
+            acc[3] += a * 255;
+          }
+        }
+        unsigned int out = 0;
+        for (int c = 0; c < 4; ++c)out |= static_cast<unsigned int>(acc[c] * scale + 0.5f) << (c * 8);
+        dst[static_cast<size_t>(y) * w + x] = out;
+#endif
+      }
+    }
+  }
+
+  // Maps the atlas file, creating it if needed. A file made for another cell size or version starts over.
+  bool open(const fs::path& path) {
+    close();
+    std::lock_guard<std::mutex> lock(mtx);
+#ifdef _WIN32
+    file = CreateFileW(path.c_str(), GENERIC_READ | GENERIC_WRITE, FILE_SHARE_READ, NULL, OPEN_ALWAYS, FILE_ATTRIBUTE_NORMAL, NULL);
+    if (file == INVALID_HANDLE_VALUE)return false;
+    LARGE_INTEGER bytes;
+    if (!GetFileSizeEx(file, &bytes))bytes.QuadPart = 0;
+    uint64_t fileSize = static_cast<uint64_t>(bytes.QuadPart);
+#else
+    fd = ::open(path.c_str(), O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+    if (fd < 0)return false;
+    struct stat st;
+    uint64_t fileSize = fstat(fd, &st) == 0 ? static_cast<uint64_t>(st.st_size) : 0;
+#endif
+    // The pages the header claims, if the file really holds them.
+    uint32_t pages = 0;
+    if (fileSize >= sizeof(Header)) {
+      Header h{};
+#ifdef _WIN32
+      DWORD read = 0;
+      if (!ReadFile(file, &h, sizeof(h), &read, NULL) || read != sizeof(h))h = Header{};
+#else
+      if (pread(fd, &h, sizeof(h), 0) != static_cast<ssize_t>(sizeof(h)))h = Header{};
+#endif
+      if (std::memcmp(h.magic, Magic, sizeof(Magic)) == 0 && h.version == Version && h.thumbWidth == static_cast<uint32_t>(thumbWidth)
+        && h.thumbHeight == static_cast<uint32_t>(thumbHeight) && h.pageSize == static_cast<uint32_t>(PageSize)
+        && h.thumbs <= MaxThumbs && h.thumbs <= static_cast<uint64_t>(h.pages) * perPage && fileSize >= size(h.pages))
+        pages = h.pages;
+      else fileSize = 0;
+    }
+    if ((fileSize == 0 || fileSize != size(pages)) && !resize(pages)) {
+      closeLocked();
+      return false;
+    }
+#ifdef _WIN32
+    if (mapping == NULL && !resize(pages)) {
+      closeLocked();
+      return false;
+    }
+#endif
+    view = map(0, static_cast<size_t>(PagesOffset));
+    if (!view) {
+      closeLocked();
+      return false;
+    }
+    header = static_cast<Header*>(view);
+    table = reinterpret_cast<Entry*>(header + 1);
+    if (fileSize == 0) {
+      std::memset(view, 0, static_cast<size_t>(PagesOffset));
+      std::memcpy(header->magic, Magic, sizeof(Magic));
+      header->version = Version;
+      header->thumbWidth = thumbWidth;
+      header->thumbHeight = thumbHeight;
+      header->pageSize = PageSize;
+    }
+    textures.assign(header->pages, -1);
+    stale.assign(header->pages, 0);
+    usedAt.assign(header->pages, 0);
+    return true;
+  }
+  void close() {
+    std::lock_guard<std::mutex> lock(mtx);
+    closeLocked();
+  }
+private:
+  void closeLocked() {
+    if (view)unmap(view, static_cast<size_t>(PagesOffset));
+#ifdef _WIN32
+    if (mapping != NULL)CloseHandle(mapping);
+    if (file != INVALID_HANDLE_VALUE)CloseHandle(file);
+    file = INVALID_HANDLE_VALUE;
+    mapping = NULL;
+#else
+    if (fd >= 0)::close(fd);
+    fd = -1;
+#endif
+    view = nullptr;
+    header = nullptr;
+    table = nullptr;
+  }
+public:
+  bool isOpen() {
+    std::lock_guard<std::mutex> lock(mtx);
+    return header != nullptr;
+  }
+  int width() const {
+    return thumbWidth;
+  }
+  int height() const {
+    return thumbHeight;
+  }
+
+  bool contains(uint64_t key) {
+    std::lock_guard<std::mutex> lock(mtx);
+    return header && lookup(key)->key == key;
+  }
+  // Where the icon with the given key sits, or false if it is not in the atlas (yet).
+  bool find(uint64_t key, Region& r) {
+    std::lock_guard<std::mutex> lock(mtx);
+    if (!header)return false;
+    const Entry* e = lookup(key);
+    if (e->key != key)return false;
+    r.page = static_cast<int>(e->slot / perPage);
+    int x = e->slot % perPage % perRow * thumbWidth, y = e->slot % perPage / perRow * thumbHeight;
+    r.u1 = static_cast<float>(x) / PageSize;
+    r.v1 = static_cast<float>(y) / PageSize;
+    r.u2 = static_cast<float>(x + thumbWidth) / PageSize;
+    r.v2 = static_cast<float>(y + thumbHeight) / PageSize;
+    return true;
+  }
+  // Queues a decoded icon to be shrunk into the atlas. The key is taken before the file is read, so an
+  // icon that changes in between is stored under the old key and read again next time.
+  void add(uint64_t key, std::shared_ptr<const Pixels> pixels) {
+    if (!pixels || key == 0)return;
+    {
+      std::lock_guard<std::mutex> lock(mtx);
+      if (!header)return;
+      jobs.push_back({ key, std::move(pixels) });
+    }
+    cv.notify_one();
+  }
+  // Blocks until at most maxQueued icons wait to be shrunk.
+  void wait(size_t maxQueued = 0) {
+    std::unique_lock<std::mutex> lock(mtx);
+    doneCv.wait(lock, [&] { return jobs.size() <= maxQueued && (maxQueued > 0 || !busy); });
+  }
+  // The worker holds off while a game runs.
+  void pause(bool p) {
+    {
+      std::lock_guard<std::mutex> lock(mtx);
+      paused = p;
+    }
+    cv.notify_all();
+  }
+
+  // The texture of a page, created from the file the first time it is drawn and again after icons were
+  // added to it. -1 if the page cannot be read.
+  int texture(int page) {
+    std::lock_guard<std::mutex> lock(mtx);
+    if (!header || page < 0 || static_cast<uint32_t>(page) >= header->pages)return -1;
+    if (textures.size() < header->pages) {
+      textures.resize(header->pages, -1);
+      stale.resize(header->pages, 0);
+      usedAt.resize(header->pages, 0);
+    }
+    usedAt[page] = ++uses;
+    if (textures[page] != -1 && !stale[page])return textures[page];
+    if (textures[page] != -1)platform.deleteGraph(textures[page]);
+    textures[page] = -1;
+    size_t resident = 0;
+    for (int t : textures)
+      if (t != -1)++resident;
+    while (resident >= maxResident) {
+      size_t oldest = textures.size();
+      for (size_t i = 0; i < textures.size(); ++i)
+        if (textures[i] != -1 && (oldest == textures.size() || usedAt[i] < usedAt[oldest]))oldest = i;
+      platform.deleteGraph(textures[oldest]);
+      textures[oldest] = -1;
+      --resident;
+    }
+    TraceSpan span("atlas page");
+    void* pixels = map(size(page), PageBytes);
+    if (!pixels)return -1;
+    textures[page] = platform.createTexture(static_cast<const unsigned int*>(pixels), PageSize, PageSize);
+    unmap(pixels, PageBytes);
+    stale[page] = 0;
+    return textures[page];
+  }
+  // Frees the page textures while a game runs; they are made again when next drawn.
+  void release() {
+    for (int& t : textures) {
+      if (t != -1)platform.deleteGraph(t);
+      t = -1;
+    }
+  }
+
+  size_t thumbs() {
+    std::lock_guard<std::mutex> lock(mtx);
+    return header ? header->thumbs : 0;
+  }
+  size_t pages() {
+    std::lock_guard<std::mutex> lock(mtx);
+    return header ? header->pages : 0;
+  }
+};
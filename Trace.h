@@ -0,0 +1,204 @@
+#pragma once
+#include <filesystem>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <atomic>
+#include <chrono>
+#include <vector>
+#include <string>
+#include <string_view>
+#include <cstdint>
+
+namespace fs = std::filesystem;
+
+// Timeline of spans and counters, written as Chrome trace JSON (chrome://tracing, ui.perfetto.dev).
+// Each thread appends to a buffer of its own under that buffer's mutex, which only flush() ever contends
+// for; while tracing is off a span costs one relaxed load. Names must be string literals, they are stored
+// as pointers. flush() appends what was recorded since the previous flush to the file and empties the
+// buffers, so a long session keeps its whole timeline and every flush leaves a complete trace.
+class Trace {
+public:
+  // Per thread between two flushes; beyond that the oldest events are overwritten and counted as dropped,
+  // so that the latest ones (a launch after hours in the menu) are always kept.
+  static constexpr size_t MaxEvents = 256 * 1024;
+private:
+  struct Event {
+    const char* name;
+    char phase;
+    long long ts;
+    long long value;
+  };
+  struct Buffer {
+    std::mutex mtx;
+    // A ring once full: the oldest event is at head.
+    std::vector<Event> events;
+    size_t head = 0;
+    uint32_t tid = 0;
+    const char* threadName = nullptr;
+    bool named = false;
+    size_t dropped = 0;
+  };
+  struct Registry {
+    std::atomic<bool> enabled{ false };
+    std::mutex mtx;
+    std::vector<std::shared_ptr<Buffer>> buffers;
+    // The file flush() appends to, and how many events it holds.
+    std::mutex flushMtx;
+    fs::path file;
+    size_t written = 0;
+  };
+  static constexpr std::string_view Closer = "\n]}\n";
+  static Registry& registry() {
+    static Registry r;
+    return r;
+  }
+  static Buffer& buffer() {
+    thread_local std::shared_ptr<Buffer> local = [] {
+      auto b = std::make_shared<Buffer>();
+      std::lock_guard<std::mutex> lock(registry().mtx);
+      b->tid = static_cast<uint32_t>(registry().buffers.size() + 1);
+      registry().buffers.push_back(b);
+      return b;
+    }();
+    return *local;
+  }
+  static void push(const char* name, char phase, long long ts, long long value) {
+    Buffer& b = buffer();
+    std::lock_guard<std::mutex> lock(b.mtx);
+    if (b.events.size() < MaxEvents) {
+      if (b.events.empty())b.events.reserve(4096);
+      b.events.push_back({ name, phase, ts, value });
+      return;
+    }
+    b.events[b.head] = { name, phase, ts, value };
+    b.head = (b.head + 1) % MaxEvents;
+    ++b.dropped;
+  }
+  static void escape(std::ostream& os, const char* s) {
+    for (; *s; ++s) {
+      if (*s == '"' || *s == '\\')os << '\\';
+      os << *s;
+    }
+  }
+public:
+  static bool enabled() {
+    return registry().enabled.load(std::memory_order_relaxed);
+  }
+  static void enable(bool on) {
+    registry().enabled.store(on, std::memory_order_relaxed);
+  }
+  // Microseconds on the steady clock, the time base of every event.
+  static long long now() {
+    return us(std::chrono::steady_clock::now());
+  }
+  static long long us(std::chrono::steady_clock::time_point t) {
+    return std::chrono::duration_cast<std::chrono::microseconds>(t.time_since_epoch()).count();
+  }
+
+  // A span that was timed by the caller, e.g. one that starts and ends in different functions.
+  static void complete(const char* name, long long startUs, long long endUs) {
+    if (!enabled())return;
+    push(name, 'X', startUs, endUs - startUs);
+  }
+  static void counter(const char* name, long long value) {
+    if (!enabled())return;
+    push(name, 'C', now(), value);
+  }
+  static void instant(const char* name) {
+    if (!enabled())return;
+    push(name, 'i', now(), 0);
+  }
+  // Shown as the thread's row title.
+  static void nameThread(const char* name) {
+    Buffer& b = buffer();
+    std::lock_guard<std::mutex> lock(b.mtx);
+    b.threadName = name;
+  }
+
+  // Appends everything recorded since the previous flush to file, or starts the file over if this is the
+  // first flush to it.
+  static bool flush(const fs::path& file) {
+    Registry& r = registry();
+    std::lock_guard<std::mutex> flushLock(r.flushMtx);
+    std::vector<std::shared_ptr<Buffer>> buffers;
+    {
+      std::lock_guard<std::mutex> lock(r.mtx);
+      buffers = r.buffers;
+    }
+    std::fstream os;
+    bool fresh = r.file != file;
+    if (!fresh) {
+      // Writes over the closing brackets of the previous flush.
+      os.open(file, std::ios::in | std::ios::out | std::ios::binary);
+      fresh = !os.is_open() || !os.seekp(-static_cast<std::streamoff>(Closer.size()), std::ios::end);
+    }
+    if (fresh) {
+      os.close();
+      os.clear();
+      os.open(file, std::ios::out | std::ios::trunc | std::ios::binary);
+      if (!os.is_open())return false;
+      os << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n";
+      r.file = file;
+      r.written = 0;
+    }
+    auto begin = [&] {
+      if (r.written++ > 0)os << ",\n";
+    };
+    std::vector<Event> events;
+    for (const auto& b : buffers) {
+      const char* threadName;
+      size_t head, dropped;
+      {
+        std::lock_guard<std::mutex> lock(b->mtx);
+        events.swap(b->events);
+        b->events.clear();
+        head = b->head;
+        b->head = 0;
+        dropped = b->dropped;
+        b->dropped = 0;
+        if (fresh)b->named = false;
+        threadName = b->named ? nullptr : b->threadName;
+        if (threadName)b->named = true;
+      }
+      if (threadName) {
+        begin();
+        os << "{\"ph\":\"M\",\"name\":\"thread_name\",\"pid\":1,\"tid\":" << b->tid << ",\"args\":{\"name\":\"";
+        escape(os, threadName);
+        os << "\"}}";
+      }
+      for (size_t i = 0; i < events.size(); ++i) {
+        const Event& e = events[(head + i) % events.size()];
+        begin();
+        os << "{\"ph\":\"" << e.phase << "\",\"name\":\"";
+        escape(os, e.name);
+        os << "\",\"pid\":1,\"tid\":" << b->tid << ",\"ts\":" << e.ts;
+        if (e.phase == 'X')os << ",\"dur\":" << e.value;
+        else if (e.phase == 'C')os << ",\"args\":{\"value\":" << e.value << "}";
+        else os << ",\"s\":\"t\"";
+        os << "}";
+      }
+      // Counts what was overwritten since the previous flush, at the first event kept.
+      if (dropped > 0) {
+        begin();
+        os << "{\"ph\":\"C\",\"name\":\"dropped events\",\"pid\":1,\"tid\":" << b->tid << ",\"ts\":"
+          << events[head].ts << ",\"args\":{\"value\":" << dropped << "}}";
+      }
+    }
+    os << Closer;
+    return os.good();
+  }
+};
+
+// Records the enclosing scope as a span.
+class TraceSpan {
+  const char* name;
+  long long start;
+public:
+  explicit TraceSpan(const char* name) : name(name), start(Trace::enabled() ? Trace::now() : -1) {}
+  TraceSpan(const TraceSpan&) = delete;
+  TraceSpan& operator=(const TraceSpan&) = delete;
+  ~TraceSpan() {
+    if (start >= 0)Trace::complete(name, start, Trace::now());
+  }
+};